@@ -62,17 +62,10 @@ main (int argc, char **argv)
 
 	CanFrame frame(true, ccvsFrame->getIdentifier());
 
-	sender->sendFrame(frame, 100, [ccvsFrame](u32 id, std::string& data) {		//We need to modify speed dynamically
+	sender->sendFrame(frame, 100, [ccvsFrame](u32 id, u8* data, size_t& length) {		//We need to modify speed dynamically
 
-		size_t length = ccvsFrame->getDataLength();
-		u8* buff = new u8[length];
-
-		ccvsFrame->encode(id, buff, length);
-
-		//Set data
-		data.append((char*)buff, length);
-
-		delete[] buff;
+		//Encoded directly in the buffer of the frame
+		ccvsFrame->encode(id, data, length);
 
 	});
 
@@ -68,9 +68,9 @@ main (int argc, char **argv)
 	rpm->setFormattedValue(310);		//310 rpm
 
 
-	std::pair<u64, CanFrame> pairTStampFrame;
+	std::pair<TimeStamp, CanFrame> pairTStampFrame;
 
-	u64 eec1TimeStamp = 0;
+	TimeStamp eec1TimeStamp;
 
 	do {
 
@@ -78,7 +78,7 @@ main (int argc, char **argv)
 
 		pairTStampFrame = trcReader.getLastCanFrame();
 
-		u64 timeStamp = pairTStampFrame.first;
+		const TimeStamp& timeStamp = pairTStampFrame.first;
 		const CanFrame& frame = pairTStampFrame.second;
 
 		if(eec1TimeStamp < timeStamp) {
@@ -98,13 +98,13 @@ main (int argc, char **argv)
 
 			CanFrame frame(true, id, data);
 
-			writer.write(frame, TimeStamp(eec1TimeStamp/1000000, eec1TimeStamp % 1000000));
+			writer.write(frame, eec1TimeStamp);
 
-			eec1TimeStamp += 100000;			//100ms
+			eec1TimeStamp = eec1TimeStamp + 100;			//100ms
 		}
 
 
-		writer.write(frame, TimeStamp(timeStamp/1000000, timeStamp % 1000000));
+		writer.write(frame, timeStamp);
 
 
 		progress = 100 * trcReader.getCurrentPos() / trcReader.getNumberOfFrames();
@@ -0,0 +1,160 @@
+//============================================================================
+// Name        : CaptureConverter.cpp
+// Author      :
+// Version     :
+// Copyright   : MIT License
+// Description : Converts TRC files to binary captures and the other way round,
+// depending on the format of the input file.
+//============================================================================
+
+#include <getopt.h>
+#include <stdlib.h>
+
+#include <iostream>
+
+// Can includes
+#include <BinaryCaptureReader.h>
+#include <BinaryCaptureWriter.h>
+#include <TRCReader.h>
+#include <TRCWriter.h>
+
+using namespace Can;
+using namespace Utils;
+
+int toTRC(BinaryCaptureReader &reader, const std::string &output);
+int toBinary(const std::string &input, const std::string &output,
+			 const std::string &interface, size_t threads);
+
+int main(int argc, char **argv)
+{
+	std::string input, output, interface;
+	size_t threads = 0; // As many as cores
+
+	static struct option long_options[] = {
+		{"input", required_argument, NULL, 'i'},
+		{"output", required_argument, NULL, 'o'},
+		{"interface", required_argument, NULL, 'n'},
+		{"threads", required_argument, NULL, 'j'},
+		{NULL, 0, NULL, 0}};
+
+	while (1) {
+		int c = getopt_long(argc, argv, "i:o:n:j:", long_options, NULL);
+
+		/* Detect the end of the options. */
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'i':
+			input = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'n':
+			interface = optarg;
+			break;
+		case 'j':
+			threads = atoi(optarg);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (input.empty() || output.empty()) {
+		std::cerr << "Usage: " << argv[0]
+				  << " -i input -o output [-n interface] [-j threads]"
+				  << std::endl;
+		return 1;
+	}
+
+	BinaryCaptureReader reader;
+
+	if (reader.loadFile(input)) {
+		return toTRC(reader, output);
+	}
+
+	return toBinary(input, output, interface, threads);
+}
+
+int toTRC(BinaryCaptureReader &reader, const std::string &output)
+{
+	// Version 2.0 to keep the CAN FD frames and the microseconds
+	TRCWriter writer;
+
+	if (!writer.open(output, TRCWriter::VERSION_2_0)) {
+		std::cerr << "File could not be opened for writing..." << std::endl;
+		return 2;
+	}
+
+	try {
+		while (!reader.isEndOfFile()) {
+			reader.readNextCanFrame();
+
+			std::pair<TimeStamp, CanFrame> pair = reader.getLastCanFrame();
+
+			writer.write(pair.second, pair.first);
+		}
+	} catch (BinaryCaptureReadException &e) {
+		std::cerr << e.what() << " after " << reader.getCurrentPos()
+				  << " frames" << std::endl;
+		return 3;
+	}
+
+	writer.close();
+
+	std::cout << reader.getNumberOfFrames() << " frames written to TRC"
+			  << std::endl;
+
+	return 0;
+}
+
+int toBinary(const std::string &input, const std::string &output,
+			 const std::string &interface, size_t threads)
+{
+	TRCReader reader;
+
+	// Checked while converting
+	if (!reader.loadFile(input, TRCReader::MAPPED)) {
+		std::cerr << "The input is neither a binary capture nor a TRC file"
+				  << std::endl;
+		return 2;
+	}
+
+	BinaryCaptureWriter writer;
+
+	if (!writer.open(output)) {
+		std::cerr << "File could not be opened for writing..." << std::endl;
+		return 2;
+	}
+
+	if (!interface.empty())
+		writer.setInterface(0, interface);
+
+	size_t written = 0;
+
+	bool valid = reader.parseFrames(
+		[&](const CanFrame *frames, const TimeStamp *tStamps, size_t count) {
+			for (size_t i = 0; i < count; ++i) {
+				writer.write(frames[i], tStamps[i]);
+			}
+
+			written += count;
+			return true;
+		},
+		threads);
+
+	writer.close();
+
+	if (!valid) {
+		std::cerr << "TRC file is corrupted after " << written << " frames"
+				  << std::endl;
+		return 3;
+	}
+
+	std::cout << written << " frames written to the binary capture"
+			  << std::endl;
+
+	return 0;
+}
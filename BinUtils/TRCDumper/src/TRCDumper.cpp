@@ -4,25 +4,39 @@
 // Version     :
 // Copyright   : MIT License
 // Description : Application that reads frames from the can interface and writes
-// them to a file in TRC format.
+// them to a file in TRC format, or in the binary capture format.
 //============================================================================
 
 #include <getopt.h>
 #include <signal.h>
+#include <stdlib.h>
 
 #include <iostream>
+#include <map>
 
 // Can includes
+#include <BinaryCaptureWriter.h>
 #include <CanEasy.h>
 #include <TRCWriter.h>
 
 // Bitrate for J1939 protocol
 #define BAUD_250K 250000
 
+// Options without short version. The ones of the tuning are told apart by
+// their name.
+#define OPT_TUNING 256
+#define OPT_BINARY 257
+
 using namespace Can;
 using namespace Utils;
 
 TRCWriter writer;
+BinaryCaptureWriter binaryWriter;
+bool binary = false;
+
+// Identifiers of the interfaces in the binary capture
+std::map<std::string, u8> interfaceIds;
+
 bool firstFrame;
 TimeStamp initialTimeStamp;
 
@@ -40,10 +54,21 @@ int main(int argc, char **argv)
 	static struct option long_options[] = {
 		{"interface", required_argument, NULL, 'i'},
 		{"file", required_argument, NULL, 'f'},
+		{"rcvbuf", required_argument, NULL, OPT_TUNING},
+		{"sndbuf", required_argument, NULL, OPT_TUNING},
+		{"force-buffers", no_argument, NULL, OPT_TUNING},
+		{"busy-poll", required_argument, NULL, OPT_TUNING},
+		{"cpu", required_argument, NULL, OPT_TUNING},
+		{"irq-cpu", required_argument, NULL, OPT_TUNING},
+		{"binary", no_argument, NULL, OPT_BINARY},
 		{NULL, 0, NULL, 0}};
 
+	ICanHelper::Tuning tuning;
+	bool tune = false;
+
 	while (1) {
-		int c = getopt_long(argc, argv, "s:i:", long_options, NULL);
+		int index;
+		int c = getopt_long(argc, argv, "s:i:", long_options, &index);
 
 		/* Detect the end of the options. */
 		if (c == -1)
@@ -56,11 +81,27 @@ int main(int argc, char **argv)
 		case 'i':
 			interface = optarg;
 			break;
+		case OPT_TUNING:
+			if (!tuning.parseOption(long_options[index].name,
+									optarg ? optarg : "")) {
+				std::cerr << "The socket options must be numbers..."
+						  << std::endl;
+				return 1;
+			}
+			tune = true;
+			break;
+		case OPT_BINARY:
+			binary = true;
+			break;
 		default:
 			break;
 		}
 	}
 
+	// Applied to the given interface or to all of them
+	if (tune)
+		ICanHelper::setTuning(interface, tuning);
+
 	CanEasy::initialize(BAUD_250K, onRcv, onTimeout);
 
 	CanSniffer &sniffer = CanEasy::getSniffer();
@@ -70,7 +111,9 @@ int main(int argc, char **argv)
 		return 2;
 	}
 
-	if (!writer.open(file)) {
+	// Version 2.0 to keep the CAN FD frames, which the interfaces receive
+	if (binary ? !binaryWriter.open(file)
+			   : !writer.open(file, TRCWriter::VERSION_2_0)) {
 		std::cerr << "File could not be opened for writing..." << std::endl;
 		return 2;
 	}
@@ -81,14 +124,31 @@ int main(int argc, char **argv)
 }
 
 void onRcv(const Can::CanFrame &frame, const TimeStamp &timeStamp,
-		   const std::string &, void *)
+		   const std::string &interface, void *)
 {
 	if (firstFrame) {
 		initialTimeStamp = timeStamp;
 		firstFrame = false;
 	}
 
-	writer.write(frame, timeStamp - initialTimeStamp);
+	if (!binary) {
+		writer.write(frame, timeStamp - initialTimeStamp);
+		return;
+	}
+
+	auto iter = interfaceIds.find(interface);
+
+	if (iter == interfaceIds.end()) {
+		u8 id = interfaceIds.size();
+
+		// Frames of the interfaces beyond the limit are not written
+		if (!binaryWriter.setInterface(id, interface))
+			return;
+
+		iter = interfaceIds.insert(std::make_pair(interface, id)).first;
+	}
+
+	binaryWriter.write(frame, timeStamp - initialTimeStamp, iter->second);
 }
 
 bool onTimeout()
@@ -101,6 +161,7 @@ void onSignal(int)
 	std::cout << "Closing file..." << std::endl;
 
 	writer.close();
+	binaryWriter.close();
 
 	std::cout << "Done" << std::endl;
 
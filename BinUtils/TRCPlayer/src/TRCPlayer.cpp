@@ -99,9 +99,8 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
-	std::cout << "Loading file..." << std::endl;
-
-	if (!reader.loadFile(file)) {
+	// Start playing while the file is checked
+	if (!reader.loadFile(file, TRCReader::LAZY)) {
 		std::cerr << "File could not be opened for reading..." << std::endl;
 		return 2;
 	}
@@ -111,7 +110,7 @@ int main(int argc, char **argv)
 		return 3;
 	}
 
-	std::pair<u64, CanFrame> pairTStampFrame;
+	std::pair<TimeStamp, CanFrame> pairTStampFrame;
 
 	if (!J1939Factory::getInstance().registerDatabaseFrames(DATABASE_PATH)) {
 		std::cerr << "Database not found in " << DATABASE_PATH << std::endl;
@@ -135,16 +134,20 @@ int main(int argc, char **argv)
 	TimeStamp lastPrintTime = TimeStamp::now();
 
 	do {
-		reader.readNextCanFrame();
+		try {
+			reader.readNextCanFrame();
+		} catch (TRCReadException &) {
+			endwin();
+			std::cerr << "Malformed record after frame "
+					  << reader.getCurrentPos() + 1 << std::endl;
+			return 5;
+		}
 
 		pairTStampFrame = reader.getLastCanFrame();
 
 		const CanFrame &frame = pairTStampFrame.second;
 
-		TimeStamp aux(pairTStampFrame.first / 1000000,
-					  pairTStampFrame.first % 1000000);
-
-		TimeStamp lastTs(start + aux);
+		TimeStamp lastTs(start + pairTStampFrame.first);
 
 		// While waiting, we try to read arrow keys
 		while (TimeStamp::now() < lastTs) {
@@ -178,14 +181,17 @@ int main(int argc, char **argv)
 
 		sender->sendFrameOnce(frame);
 
+		// The number of frames is estimated until the file has been checked
 		progress = width * reader.getCurrentPos() / reader.getNumberOfFrames();
 
+		if (progress > (u32)width)
+			progress = width;
+
 		try {
 			// Try to print frames
 			std::unique_ptr<J1939Frame> j1939Frame =
 				J1939Factory::getInstance().getJ1939Frame(
-					frame.getId(), (const u8 *)(frame.getData().c_str()),
-					frame.getData().size());
+					frame.getId(), frame.getRawData(), frame.getDataLength());
 
 			if (j1939Frame) { // Frame registered in the factory?
 
@@ -232,7 +238,9 @@ int main(int argc, char **argv)
 			lastPrintTime = TimeStamp::now();
 		}
 
-	} while (reader.getCurrentPos() < reader.getNumberOfFrames() - 1);
+	} while (reader.isNumberOfFramesExact()
+				 ? reader.getCurrentPos() < reader.getNumberOfFrames() - 1
+				 : !reader.isEndOfFile());
 
 	// Finalize ncurses
 	endwin();
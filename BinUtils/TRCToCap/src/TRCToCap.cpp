@@ -8,6 +8,7 @@
 extern "C" {
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <getopt.h>
 #include <glib.h>
 #include <pcapio.h>		//To write cap files
@@ -15,6 +16,7 @@ extern "C" {
 }
 
 
+#include <algorithm>
 #include <iostream>
 #include <TRCReader.h>	//To read TRC files
 
@@ -26,24 +28,27 @@ extern "C" {
 
 
 using namespace Can;
+using namespace Utils;
 
 int main(int argc, char **argv) {
 
 	//Get options
 	int c;
 	std::string input, output;
+	size_t threads = 0;		//As many as cores
 
 	static struct option long_options[] =
 	{
 		{"input", required_argument, NULL, 'i'},
 		{"output", required_argument, NULL, 'o'},
+		{"threads", required_argument, NULL, 'j'},
 		{NULL, 0, NULL, 0}
 	};
 
 	while (1)
 	{
 
-		c = getopt_long (argc, argv, "i:o:",
+		c = getopt_long (argc, argv, "i:o:j:",
 				   long_options, NULL);
 
 		/* Detect the end of the options. */
@@ -58,6 +63,9 @@ int main(int argc, char **argv) {
 		case 'o':
 			output = optarg;
 			break;
+		case 'j':
+			threads = atoi(optarg);
+			break;
 		default:
 			break;
 		}
@@ -75,16 +83,12 @@ int main(int argc, char **argv) {
 
 	TRCReader trcReader;
 
-	if(!trcReader.loadFile(input)) {
+	//Checked while converting
+	if(!trcReader.loadFile(input, TRCReader::MAPPED)) {
 		std::cerr << "TRC file is corrupted or not readable by " << argv[0] << std::endl;
 		return -2;
 	}
 
-	if(trcReader.getNumberOfFrames() == 0) {
-		std::cerr << "TRC file is empty" << std::endl;
-		return -3;
-	}
-
 	std::cout << "TRC file loaded" << std::endl;
 
 	FILE *fd = fopen(output.c_str(), "wb");
@@ -97,52 +101,54 @@ int main(int argc, char **argv) {
 
 	guint64 bytes_written;
 	int err;
-	std::pair<u64, CanFrame> pairTStampFrame;
 
 	libpcap_write_file_header(fd, CAN_LINKTYPE, 0xFFFF, TRUE, &bytes_written, &err);
 
 	std::cout << "Header written" << std::endl;
 
+	size_t written = 0;
 	int progress = 0, oldProgress = 0;
 
-	//Iterate over the frames
-	do {
+	//The frames are parsed by several threads and written in order
+	bool valid = trcReader.parseFrames([&](const CanFrame *frames, const TimeStamp *tStamps, size_t count) {
 
-		trcReader.readNextCanFrame();
+		for(size_t i = 0; i < count; ++i) {
 
-		pairTStampFrame = trcReader.getLastCanFrame();
+			const TimeStamp& timeStamp = tStamps[i];
 
-		u64 timeStamp = pairTStampFrame.first;
+			const CanFrame& frame = frames[i];
 
-		const CanFrame& frame = pairTStampFrame.second;
+			size_t length = CAN_ID_LENGTH + LENGTH_LENGTH + RESERVED_LENGTH + frame.getDataLength();
 
-		size_t length = CAN_ID_LENGTH + LENGTH_LENGTH + RESERVED_LENGTH + frame.getData().size();
+			std::string data;
 
-		std::string data;
 
+			//Add the ID
+			data += (((frame.getId() >> 24) & 0xFF) | (frame.isExtendedFormat() ? 0x80 : 0x00));		//Extended flag present?
+			data += ((frame.getId() >> 16) & 0xFF);
+			data += ((frame.getId() >> 8) & 0xFF);
+			data += (frame.getId() & 0xFF);
 
-		//Add the ID
-		data += (((frame.getId() >> 24) & 0xFF) | (frame.isExtendedFormat() ? 0x80 : 0x00));		//Extended flag present?
-		data += ((frame.getId() >> 16) & 0xFF);
-		data += ((frame.getId() >> 8) & 0xFF);
-		data += (frame.getId() & 0xFF);
+			//Add the length
+			data += frame.getDataLength();
 
-		//Add the length
-		data += frame.getData().size();
+			//Add the reserved characters
+			data += (char)0;
+			data += (char)0;
+			data += (char)0;
 
-		//Add the reserved characters
-		data += (char)0;
-		data += (char)0;
-		data += (char)0;
+			//Append the DLC of the frame
+			data.append((const char *)frame.getRawData(), frame.getDataLength());
 
-		//Append the DLC of the frame
-		data += frame.getData();
 
+			libpcap_write_packet(fd, timeStamp.getSeconds(), timeStamp.getMicroSec(), length, length, (const guint8 *)(data.c_str()),
+					&bytes_written, &err);
+		}
 
-		libpcap_write_packet(fd, timeStamp / 1000000, timeStamp % 1000000, length, length, (const guint8 *)(data.c_str()),
-				&bytes_written, &err);
+		written += count;
 
-		progress = 100 * trcReader.getCurrentPos() / trcReader.getNumberOfFrames();
+		//Estimated from the size of the file
+		progress = std::min<size_t>(100, 100 * written / std::max<size_t>(trcReader.getNumberOfFrames(), 1));
 
 		if(progress != oldProgress) {
 			std::cout << "Progress: " << progress << " %" << std::endl;
@@ -150,10 +156,22 @@ int main(int argc, char **argv) {
 
 		oldProgress = progress;
 
-	} while(trcReader.getCurrentPos() < trcReader.getNumberOfFrames() - 1);
+		return true;
+
+	}, threads);
 
 	fclose(fd);
 
+	if(!valid) {
+		std::cerr << "TRC file is corrupted after " << written << " frames" << std::endl;
+		return -2;
+	}
+
+	if(written == 0) {
+		std::cerr << "TRC file is empty" << std::endl;
+		return -3;
+	}
+
 	std::cout << "Cap file correctly generated" << std::endl;
 
 }
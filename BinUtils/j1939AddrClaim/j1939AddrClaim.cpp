@@ -212,8 +212,7 @@ void onRcv(const CanFrame &frame, const TimeStamp &,
 {
 	std::unique_ptr<J1939Frame> j1939Frame =
 		J1939Factory::getInstance().getJ1939Frame(
-			frame.getId(), (const u8 *)(frame.getData().c_str()),
-			frame.getData().size());
+			frame.getId(), frame.getRawData(), frame.getDataLength());
 
 	if (j1939Frame) {
 		if (addresClaimer->toBeHandled(*j1939Frame)) {
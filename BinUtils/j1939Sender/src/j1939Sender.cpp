@@ -34,6 +34,7 @@
 
 // CAN includes
 #include <CanEasy.h>
+#include <CommonCanSender.h>
 
 #define VERSION_STR "1.0"
 
@@ -151,6 +152,15 @@ std::map<std::string, J1939Frame *> framesToSend;
 // Map to specify the period for the different frames (in millis)
 std::map<std::string, u32> framePeriods;
 
+// Frames sent periodically, by interface and frame. The handles publish the
+// new values of the frames without rescheduling them.
+struct SentFrame {
+	SendHandle handle;
+	u32 period;
+};
+
+std::map<std::pair<std::string, const J1939Frame *>, SentFrame> sentFrames;
+
 // Take all the tokens from a line (separated by spaces) and introduces them in
 // the list
 std::list<std::string> splitTokens(std::string);
@@ -158,6 +168,7 @@ std::list<std::string> splitTokens(std::string);
 // TTS
 std::vector<FMS1Frame> fms1Frames;
 u32 ttsPeriod;
+std::map<std::string, SendHandle> ttsHandles; // By interface
 
 bool silent;
 
@@ -200,6 +211,7 @@ void uninitializeVariables();
 bool parseSetGenericParams(const std::string &name, J1939Frame *frame,
 						   const std::string &key, const std::string &value);
 
+std::vector<CanFrame> j1939FrameToCanFrames(const J1939Frame *frame);
 void sendFrameThroughInterface(const J1939Frame *frame,
 							   const std::string &interface, u32 period = 0);
 
@@ -212,15 +224,17 @@ int main(int argc, char **argv)
 	// Get options
 	int c;
 	std::string file;
+	bool phaseOffsets = false;
 	silent = false;
 
 	static struct option long_options[] = {
 		{"file", required_argument, NULL, 'f'},
 		{"silent", no_argument, NULL, 's'},
+		{"phase-offsets", no_argument, NULL, 'p'},
 		{NULL, 0, NULL, 0}};
 
 	while (1) {
-		c = getopt_long(argc, argv, "f:s:", long_options, NULL);
+		c = getopt_long(argc, argv, "f:s:p", long_options, NULL);
 
 		/* Detect the end of the options. */
 		if (c == -1)
@@ -233,6 +247,9 @@ int main(int argc, char **argv)
 		case 's':
 			silent = true;
 			break;
+		case 'p':
+			phaseOffsets = true;
+			break;
 
 		default:
 			break;
@@ -321,6 +338,18 @@ int main(int argc, char **argv)
 	for (auto iter = ifaces.begin(); iter != ifaces.end(); ++iter) {
 		if (!silent)
 			std::cout << *iter << " ";
+
+		// Frames with the same period are spread along the period instead of
+		// being sent in bursts, and the ones due at about the same time are
+		// sent together in arbitration order
+		std::shared_ptr<CommonCanSender> sender =
+			std::dynamic_pointer_cast<CommonCanSender>(
+				CanEasy::getSender(*iter));
+
+		if (sender && phaseOffsets) {
+			sender->setPhaseOffsets(true);
+			sender->setPassWindow(CAN_SENDER_PASS_WINDOW);
+		}
 	}
 
 	if (!silent)
@@ -666,6 +695,8 @@ void parseUnsendTTSCommand()
 
 		sender->unSendFrames(ids);
 	}
+
+	ttsHandles.clear();
 }
 
 void parseSendTTSCommand(std::list<std::string> arguments)
@@ -713,7 +744,7 @@ void parseSendTTSCommand(std::list<std::string> arguments)
 
 	std::shared_ptr<ICanSender> sender = CanEasy::getSender(interface);
 
-	sender->sendFrames(frames, ttsPeriod);
+	ttsHandles[interface] = sender->sendFrames(frames, ttsPeriod);
 }
 
 void parseSetTTSCommand(std::list<std::string> arguments)
@@ -776,24 +807,12 @@ void parseSetTTSCommand(std::list<std::string> arguments)
 		if (!ttsSet) {
 			std::cerr << "TTS not found";
 		} else {
-			std::vector<u32> ids;
+			std::vector<CanFrame> frames = ttsFramesToCanFrames(fms1Frames);
 
-			for (auto iter = fms1Frames.begin(); iter != fms1Frames.end();
+			// Only where the TTS are being sent, keeping their schedule
+			for (auto iter = ttsHandles.begin(); iter != ttsHandles.end();
 				 ++iter) {
-				ids.push_back(iter->getIdentifier());
-			}
-
-			const std::set<std::string> &ifaces =
-				CanEasy::getInitializedCanIfaces();
-
-			for (auto iter = ifaces.begin(); iter != ifaces.end(); ++iter) {
-				std::shared_ptr<ICanSender> sender = CanEasy::getSender(*iter);
-
-				if (sender->isSent(ids)) {
-					std::vector<CanFrame> frames =
-						ttsFramesToCanFrames(fms1Frames);
-					sender->sendFrames(frames, ttsPeriod);
-				}
+				iter->second.updateFrames(frames);
 			}
 		}
 	}
@@ -815,9 +834,16 @@ void parsePrintFrameCommand(std::list<std::string> arguments)
 void notifySender(const J1939Frame *frame, u32 sec)
 {
 	const std::set<std::string> &ifaces = CanEasy::getInitializedCanIfaces();
+	std::vector<CanFrame> canFrames = j1939FrameToCanFrames(frame);
 
 	for (auto iter = ifaces.begin(); iter != ifaces.end(); ++iter) {
-		std::shared_ptr<ICanSender> sender = CanEasy::getSender(*iter);
+		auto sent = sentFrames.find(std::make_pair(*iter, frame));
+
+		// If only the data changed, it is published to the sender thread
+		if (sent != sentFrames.end() && sent->second.period == sec &&
+			sent->second.handle.updateFrames(canFrames)) {
+			continue;
+		}
 
 		if (isFrameSent(frame, *iter)) {
 			sendFrameThroughInterface(frame, *iter, sec);
@@ -1072,14 +1098,12 @@ void parseSendFrameCommand(std::list<std::string> arguments)
 	sendFrameThroughInterface(j1939Frame, interface, sec);
 }
 
-void sendFrameThroughInterface(const J1939Frame *j1939Frame,
-		const std::string &interface, u32 period)
+std::vector<CanFrame> j1939FrameToCanFrames(const J1939Frame *j1939Frame)
 {
 	u32 id;
 	u8 *buff;
-	std::string data;
+	std::vector<CanFrame> canFrames;
 	CanFrame canFrame;
-	std::shared_ptr<ICanSender> sender = CanEasy::getSender(interface);
 	size_t length = j1939Frame->getDataLength();
 
 	// J1939 data is always transmitted in extended format
@@ -1087,7 +1111,6 @@ void sendFrameThroughInterface(const J1939Frame *j1939Frame,
 
 	// If the frame is bigger than 8 bytes, we use BAM
 	if (length > MAX_CAN_DATA_SIZE) {
-		std::vector<CanFrame> canFrames;
 		BamFragmenter fragmenter;
 		fragmenter.fragment(*j1939Frame);
 
@@ -1132,8 +1155,6 @@ void sendFrameThroughInterface(const J1939Frame *j1939Frame,
 			canFrames.push_back(canFrame);
 		}
 
-		sender->sendFrames(canFrames, period);
-
 	} else { // Can be sent in one frame
 		buff = new u8[length];
 
@@ -1148,11 +1169,27 @@ void sendFrameThroughInterface(const J1939Frame *j1939Frame,
 		canFrame.setData(data);
 		delete[] buff;
 
-		if (period == 0)
-			sender->sendFrameOnce(canFrame);
-		else
-			sender->sendFrame(canFrame, period);
+		canFrames.push_back(canFrame);
+	}
+
+	return canFrames;
+}
+
+void sendFrameThroughInterface(const J1939Frame *j1939Frame,
+		const std::string &interface, u32 period)
+{
+	std::shared_ptr<ICanSender> sender = CanEasy::getSender(interface);
+	std::vector<CanFrame> canFrames = j1939FrameToCanFrames(j1939Frame);
+
+	if (canFrames.size() == 1 && period == 0) {
+		sender->sendFrameOnce(canFrames.front());
+		return;
 	}
+
+	SentFrame &sent = sentFrames[std::make_pair(interface, j1939Frame)];
+
+	sent.handle = sender->sendFrames(canFrames, period);
+	sent.period = period;
 }
 
 void unsendFrameThroughInterface(const J1939Frame *j1939Frame,
@@ -1188,6 +1225,7 @@ void unsendFrameThroughInterface(const J1939Frame *j1939Frame,
 
 		if (interface.empty() || interface == *iter) {
 			sender->unSendFrames(ids);
+			sentFrames.erase(std::make_pair(*iter, j1939Frame));
 			found = true;
 		}
 	}
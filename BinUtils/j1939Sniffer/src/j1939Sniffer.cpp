@@ -8,8 +8,11 @@
 #include <ncurses.h>
 
 #include <getopt.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 
 #include <iostream>
+#include <map>
 
 #include <GenericFrame.h>
 #include <J1939DataBase.h>
@@ -28,6 +31,13 @@
 #define DATABASE_PATH "/etc/j1939/frames.json"
 #endif
 
+// Period to refresh the bus statistics (millis)
+#define STATS_REFRESH_PERIOD 1000
+
+// Options without short version. The ones of the tuning are told apart by
+// their name.
+#define OPT_TUNING 256
+
 using namespace Can;
 using namespace Utils;
 using namespace J1939;
@@ -39,16 +49,29 @@ BamReassembler reassembler;
 void onRcv(const Can::CanFrame &frame, const TimeStamp &,
 		   const std::string &interface, void *);
 bool onTimeout();
+void onStatsTimer(int fd, void *);
+void onDrop(u64 dropped, u64 total, const std::string &interface, void *);
+void printScreen();
+
+// Last contents printed of the frame
+std::string lastPrinted;
+
+// Frames dropped by the receiver of every interface
+std::map<std::string, u64> droppedFrames;
 
 u32 pgn;
 u32 spn;
 std::string interface, title;
 u8 source;
 
+// Socket options and affinity of the interfaces
+ICanHelper::Tuning tuning;
+bool tune = false;
+
 int processCommand(int argc, char **argv, std::string &pgnStr,
 		std::string &spnStr, std::string &sourceStr)
 {
-	int c;
+	int c, index;
 
 	static struct option long_options[] = {
 		{"pgn", required_argument, NULL, 'p'},
@@ -56,10 +79,16 @@ int processCommand(int argc, char **argv, std::string &pgnStr,
 		{"interface", required_argument, NULL, 'i'},
 		{"title", required_argument, NULL, 't'},
 		{"source", required_argument, NULL, 'o'},
+		{"rcvbuf", required_argument, NULL, OPT_TUNING},
+		{"sndbuf", required_argument, NULL, OPT_TUNING},
+		{"force-buffers", no_argument, NULL, OPT_TUNING},
+		{"busy-poll", required_argument, NULL, OPT_TUNING},
+		{"cpu", required_argument, NULL, OPT_TUNING},
+		{"irq-cpu", required_argument, NULL, OPT_TUNING},
 		{NULL, 0, NULL, 0}};
 
 	while (1) {
-		c = getopt_long(argc, argv, "p:s:i:t:", long_options, NULL);
+		c = getopt_long(argc, argv, "p:s:i:t:", long_options, &index);
 
 		/* Detect the end of the options. */
 		if (c == -1)
@@ -81,6 +110,15 @@ int processCommand(int argc, char **argv, std::string &pgnStr,
 			case 'o':
 				sourceStr = optarg;
 				break;
+			case OPT_TUNING:
+				if (!tuning.parseOption(long_options[index].name,
+										optarg ? optarg : "")) {
+					std::cerr << "The socket options must be numbers..."
+						<< std::endl;
+					return -EINVAL;
+				}
+				tune = true;
+				break;
 			default:
 				break;
 		}
@@ -193,6 +231,10 @@ int main(int argc, char **argv)
 		}
 	}
 
+	// Applied to the given interface or to all of them
+	if (tune)
+		ICanHelper::setTuning(interface, tuning);
+
 	CanEasy::initialize(BAUD_250K, onRcv, onTimeout);
 
 	CanSniffer &sniffer = CanEasy::getSniffer();
@@ -236,6 +278,22 @@ int main(int argc, char **argv)
 	filters.insert(tpcmFilter);
 	filters.insert(tpdtFilter);
 	sniffer.setFilters(filters);
+	sniffer.setOnDrop(onDrop);
+
+	// Refresh the bus statistics periodically, even if the frame is not
+	// received
+	int timerFd = timerfd_create(CLOCK_MONOTONIC, 0);
+
+	if (timerFd != -1) {
+		itimerspec period;
+
+		period.it_value.tv_sec = STATS_REFRESH_PERIOD / 1000;
+		period.it_value.tv_nsec = (STATS_REFRESH_PERIOD % 1000) * 1000000;
+		period.it_interval = period.it_value;
+
+		timerfd_settime(timerFd, 0, &period, NULL);
+		sniffer.addUserFd(timerFd, onStatsTimer);
+	}
 
 	// Initialize ncurses
 	initscr();
@@ -243,16 +301,69 @@ int main(int argc, char **argv)
 	sniffer.sniff(1000);
 
 	endwin();
+
+	if (timerFd != -1)
+		close(timerFd);
+
 	return 0;
 }
 
+void printScreen()
+{
+	const std::set<std::string> &ifaces = CanEasy::getInitializedCanIfaces();
+
+	clear();
+
+	// Frame rate and bus load of every interface
+	for (auto iter = ifaces.begin(); iter != ifaces.end(); ++iter) {
+		std::shared_ptr<BusStatistics> statistics =
+			CanEasy::getBusStatistics(*iter);
+
+		if (!statistics)
+			continue;
+
+		BusStatistics::Snapshot snapshot = statistics->getSnapshot();
+
+		printw("%s: %.0f frames/s, %.1f kbit/s, load %.1f%% (peak %.1f%%)\n",
+			   iter->c_str(), snapshot.framesPerSecond,
+			   snapshot.bitsPerSecond / 1000, snapshot.load,
+			   snapshot.peakLoad);
+
+		auto dropped = droppedFrames.find(*iter);
+
+		if (dropped != droppedFrames.end())
+			printw("%s: %llu frames dropped\n", iter->c_str(),
+				   (unsigned long long)dropped->second);
+	}
+
+	printw("\n");
+	printw("%s", lastPrinted.c_str());
+	refresh();
+}
+
+void onStatsTimer(int fd, void *)
+{
+	u64 expirations;
+
+	if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+		return;
+
+	printScreen();
+}
+
+void onDrop(u64, u64 total, const std::string &interface, void *)
+{
+	droppedFrames[interface] = total;
+
+	printScreen();
+}
+
 void onRcv(const Can::CanFrame &frame, const TimeStamp &,
 		   const std::string &interface, void *)
 {
 	std::unique_ptr<J1939Frame> j1939Frame =
 		J1939Factory::getInstance().getJ1939Frame(
-			frame.getId(), (const u8 *)(frame.getData().c_str()),
-			frame.getData().size());
+			frame.getId(), frame.getRawData(), frame.getDataLength());
 
 	if (!j1939Frame)
 		return; // Frame not registered in the factory. Should never happen
@@ -298,9 +409,8 @@ void onRcv(const Can::CanFrame &frame, const TimeStamp &,
 			toPrint = j1939Frame->toString();
 		}
 
-		clear();
-		printw(toPrint.c_str());
-		refresh();
+		lastPrinted = toPrint;
+		printScreen();
 	}
 }
 
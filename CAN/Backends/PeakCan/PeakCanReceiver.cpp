@@ -36,18 +36,28 @@ bool PeakCanReceiver::receive(CanFrame& frame, TimeStamp& timestamp) {
 		return false;
 	}
 
-	//Set data
-	std::string data;
-	data.append((char*)message.DATA, message.LEN);
+	frame = CanFrame(message.MSGTYPE == PCAN_MESSAGE_EXTENDED, message.ID, message.DATA, message.LEN);
 
-	frame = CanFrame(message.MSGTYPE == PCAN_MESSAGE_EXTENDED, message.ID, data);
-
-	timestamp = TimeStamp(tmStamp.millis / 1000, (tmStamp.millis % 1000) * 1000 + tmStamp.micros);
+	timestamp = TimeStamp::fromNanoSec(((s64)tmStamp.millis_overflow << 32 | tmStamp.millis) * 1000000 +
+			(s64)tmStamp.micros * 1000);
 
 	return true;
 
 }
 
+size_t PeakCanReceiver::receiveBatch(CanFrame* frames, TimeStamp* tStamps, size_t max) {
+
+	size_t count = 0;
+
+	//CAN_Read does not block, keep reading until the receive queue is empty
+	while(count < max && receive(frames[count], tStamps[count])) {
+		++count;
+	}
+
+	return count;
+
+}
+
 
 int PeakCanReceiver::getFD() {
 
@@ -33,20 +33,23 @@ void PeakCanSender::_sendFrame(const CanFrame& frame) const {
 
 	TPCANMsg frameToSend;
 
+	if(frame.isFdFormat()) {		//Only classic frames supported by this backend
+		notifySendError(frame, PCAN_ERROR_ILLDATA);
+		return;
+	}
+
 
 	//Copy the frame
 	frameToSend.MSGTYPE = (frame.isExtendedFormat() ? PCAN_MESSAGE_EXTENDED : PCAN_MESSAGE_STANDARD);
 	frameToSend.ID = frame.getId();
-	frameToSend.LEN = frame.getData().size();
+	frameToSend.LEN = frame.getDataLength();
 
-	memcpy(frameToSend.DATA, frame.getData().c_str(), frameToSend.LEN);
+	memcpy(frameToSend.DATA, frame.getRawData(), frameToSend.LEN);
 
 	status = PeakCanSymbols::getInstance().CAN_Write(mCurrentHandle, &frameToSend);
 
-	if(status == PCAN_ERROR_OK) {
-		//OK
-	} else {
-		//ERROR
+	if(status != PCAN_ERROR_OK) {
+		notifySendError(frame, status);
 	}
 
 }
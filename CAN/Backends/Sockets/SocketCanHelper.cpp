@@ -20,13 +20,17 @@
 #include <linux/net_tstamp.h>
 
 #include <string.h>
+#include <ctype.h>
 
 #include <Backends/Sockets/SocketCanHelper.h>
 #include <Backends/Sockets/SocketCanSender.h>
 #include <Backends/Sockets/SocketCanReceiver.h>
+#include <Backends/Sockets/SocketCanRingReceiver.h>
 
 
 #define SYS_CLASS_NET_PATH		"/sys/class/net/"
+#define PROC_INTERRUPTS_PATH	"/proc/interrupts"
+#define PROC_IRQ_AFFINITY_PATH	"/proc/irq/%d/smp_affinity_list"
 
 /**
  * System commands to get/configure the interfaces. Much better than handling netlink sockets...
@@ -204,6 +208,7 @@ bool SocketCanHelper::initialize(std::string interface, u32 bitrate) {
 
 	const int timestamp_flags = (SOF_TIMESTAMPING_SOFTWARE | \
 										SOF_TIMESTAMPING_RX_SOFTWARE | \
+										SOF_TIMESTAMPING_RX_HARDWARE | \
 										SOF_TIMESTAMPING_RAW_HARDWARE);
 
 	//Activate timestamp
@@ -212,6 +217,12 @@ bool SocketCanHelper::initialize(std::string interface, u32 bitrate) {
 		mTimeStamp = false;			//Option not supported by kernel. Timestamp cannot be obtained.
 	}
 
+	//Get the number of frames dropped by the socket along with the received
+	//ones. Drops are just not reported if not supported.
+	int rxqOvfl = 1;
+
+	setsockopt(mSock, SOL_SOCKET, SO_RXQ_OVFL, &rxqOvfl, sizeof(rxqOvfl));
+
 	//Bind to socket to start receiving frames from the specified interface
 	addr.can_family = AF_CAN;
 	strncpy(ifr.ifr_name, interface.c_str(), IFNAMSIZ - 1);
@@ -243,6 +254,13 @@ bool SocketCanHelper::initialize(std::string interface, u32 bitrate) {
 		return false;
 	}
 
+	//Receive and send CAN FD frames if the interface supports them. Classic
+	//frames keep working if the option is not available.
+
+	int fdFrames = 1;
+
+	mFdFrames = (setsockopt(mSock, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &fdFrames, sizeof(fdFrames)) == 0);
+
 	mInterface = interface;
 
 	return true;
@@ -276,7 +294,130 @@ ICanSender* SocketCanHelper::allocateCanSender() {
 }
 
 CommonCanReceiver* SocketCanHelper::allocateCanReceiver() {
-	return new SocketCanReceiver(mSock, mTimeStamp);
+	return new SocketCanReceiver(mSock, mTimeStamp, mHardwareTimeStamp);
+}
+
+bool SocketCanHelper::applyTuning(const Tuning& tuning) {
+
+	bool retVal = true;
+
+	ICanHelper::applyTuning(tuning);
+
+	if(mSock == -1)			return false;
+
+	//The FORCE variants go beyond the limits of the system but need
+	//CAP_NET_ADMIN, fall back to the limited ones without it.
+	if(tuning.rcvBuf > 0 &&
+			!(tuning.forceBuffers && setsockopt(mSock, SOL_SOCKET, SO_RCVBUFFORCE, &tuning.rcvBuf, sizeof(tuning.rcvBuf)) == 0) &&
+			setsockopt(mSock, SOL_SOCKET, SO_RCVBUF, &tuning.rcvBuf, sizeof(tuning.rcvBuf)) < 0) {
+		retVal = false;
+	}
+
+	if(tuning.sndBuf > 0 &&
+			!(tuning.forceBuffers && setsockopt(mSock, SOL_SOCKET, SO_SNDBUFFORCE, &tuning.sndBuf, sizeof(tuning.sndBuf)) == 0) &&
+			setsockopt(mSock, SOL_SOCKET, SO_SNDBUF, &tuning.sndBuf, sizeof(tuning.sndBuf)) < 0) {
+		retVal = false;
+	}
+
+	if(tuning.busyPoll > 0 &&
+			setsockopt(mSock, SOL_SOCKET, SO_BUSY_POLL, &tuning.busyPoll, sizeof(tuning.busyPoll)) < 0) {
+		retVal = false;
+	}
+
+	if(tuning.irqCpu >= 0 && !setIrqAffinity(tuning.irqCpu)) {
+		retVal = false;
+	}
+
+	return retVal;
+
+}
+
+std::set<int> SocketCanHelper::getIrqs() const {
+
+	std::set<int> irqs;
+	int irq;
+
+	//Devices on a bus (PCI, SPI, platform...) tell their IRQ
+	std::string path = SYS_CLASS_NET_PATH + mInterface + "/device/irq";
+
+	FILE *fp = fopen(path.c_str(), "r");
+
+	if(fp != NULL) {
+		if(fscanf(fp, "%d", &irq) == 1 && irq > 0) {
+			irqs.insert(irq);
+		}
+		fclose(fp);
+	}
+
+	//Otherwise the drivers usually register the IRQs with the name of the interface
+	fp = fopen(PROC_INTERRUPTS_PATH, "r");
+
+	if(fp == NULL) {
+		return irqs;
+	}
+
+	char line[1024];
+
+	while(fgets(line, sizeof(line), fp) != NULL) {
+
+		std::string text = line;
+		size_t pos = text.find(mInterface);
+		size_t end = pos + mInterface.size();
+
+		//Whole word only, so that can1 does not match can10
+		if(pos == std::string::npos || pos == 0 || (end < text.size() && !isspace(text[end])) ||
+				!isspace(text[pos - 1]) || sscanf(line, " %d:", &irq) != 1) {
+			continue;
+		}
+
+		irqs.insert(irq);
+	}
+
+	fclose(fp);
+
+	return irqs;
+
+}
+
+bool SocketCanHelper::setIrqAffinity(int cpu) const {
+
+	std::set<int> irqs = getIrqs();
+
+	if(irqs.empty())		return false;		//Virtual interface or unknown device
+
+	for(auto irq = irqs.begin(); irq != irqs.end(); ++irq) {
+
+		char path[PATH_MAX];
+
+		snprintf(path, sizeof(path), PROC_IRQ_AFFINITY_PATH, *irq);
+
+		FILE *fp = fopen(path, "w");
+
+		if(fp == NULL) {
+			return false;			//Needs root
+		}
+
+		bool written = (fprintf(fp, "%d\n", cpu) > 0);
+
+		if(fclose(fp) != 0 || !written) {
+			return false;
+		}
+	}
+
+	return true;
+
+}
+
+CommonCanReceiver* SocketCanHelper::allocateCanRingReceiver() {
+
+	SocketCanRingReceiver *receiver = new SocketCanRingReceiver;
+
+	if(!receiver->open(mInterface)) {
+		delete receiver;
+		return nullptr;
+	}
+
+	return receiver;
 }
 
 } /* namespace Can */
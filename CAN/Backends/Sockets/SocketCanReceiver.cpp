@@ -25,7 +25,8 @@ using namespace Utils;
 namespace Can {
 namespace Sockets {
 
-SocketCanReceiver::SocketCanReceiver(int sock, bool timeStamp) : mSock(sock), mTimeStamp(timeStamp) {
+SocketCanReceiver::SocketCanReceiver(int sock, bool timeStamp, bool hardwareTimeStamp) : mSock(sock),
+		mTimeStamp(timeStamp), mHardwareTimeStamp(hardwareTimeStamp) {
 
 
 	iov.iov_base = &frame;
@@ -37,6 +38,9 @@ SocketCanReceiver::SocketCanReceiver(int sock, bool timeStamp) : mSock(sock), mT
 }
 
 SocketCanReceiver::~SocketCanReceiver() {
+
+	if(mStatsSock != -1)		close(mStatsSock);
+
 }
 
 
@@ -44,52 +48,272 @@ bool SocketCanReceiver::setFilters(std::set<CanFilter> filters) {
 
 	bool retVal;
 
-	can_filter *rfilters, *filterPtr;
+	std::vector<can_filter> rfilters;
 
 	if(mSock == -1)			return false;								//Socket is not open... nothing todo
 
 	if(filters.empty())		return false;								//No filters specified
 
-	filterPtr = rfilters = new can_filter[filters.size()]; 				//Allocate filters according to the number of them
+	rfilters.reserve(filters.size());
 
 	for(auto iter = filters.begin(); iter != filters.end(); ++iter) {
 
-		filterPtr->can_id = iter->getId() & CAN_EFF_MASK;
-		filterPtr->can_mask = iter->getMask() & CAN_EFF_MASK;
+		can_filter rfilter;
+
+		rfilter.can_id = iter->getId() & CAN_EFF_MASK;
+		rfilter.can_mask = iter->getMask() & CAN_EFF_MASK;
 
 		if(iter->filterStdFrame() == iter->filterExtFrame()) {			//If none of them are filtered or both are filtered, remove the extended frame flag from the mask
 
-			filterPtr->can_mask &= ~CAN_EFF_FLAG;
+			rfilter.can_mask &= ~CAN_EFF_FLAG;
 
 		} else {
 
-			filterPtr->can_mask |= CAN_EFF_FLAG;						//Set the flag in the mask to check if it is a standard frame or extended frame
+			rfilter.can_mask |= CAN_EFF_FLAG;							//Set the flag in the mask to check if it is a standard frame or extended frame
 
 			if(iter->filterExtFrame()) {
 
-				filterPtr->can_id |= CAN_EFF_FLAG;						//If it is extended, we set the EFF flag
+				rfilter.can_id |= CAN_EFF_FLAG;							//If it is extended, we set the EFF flag
 			} else {
-				filterPtr->can_mask &= CAN_SFF_MASK;					//If it is standard, we set to 0 the unnecessary bits from the id (only 11 bits)
+				rfilter.can_mask &= CAN_SFF_MASK;						//If it is standard, we set to 0 the unnecessary bits from the id (only 11 bits)
 			}
 
 		}
 
-		++filterPtr;
+		rfilters.push_back(rfilter);
+
+	}
+
+	optimizeFilters(rfilters);
+
+	//The statistics need all the frames from the bus. They are taken from another socket without filters, or if it
+	//could not be opened, the socket accepts all the frames and they are filtered in user space.
+	if(getBusStatistics() && mStatsSock == -1) {
+
+		can_filter all;
 
+		all.can_id = 0;
+		all.can_mask = 0;
+
+		if(setsockopt(mSock, SOL_CAN_RAW, CAN_RAW_FILTER, &all, sizeof(all)) != 0)		return false;
+
+		mKernelFilters = 0;
+
+		return CommonCanReceiver::setFilters(filters);
 	}
 
 	retVal = (setsockopt(mSock, SOL_CAN_RAW, CAN_RAW_FILTER,
-			rfilters, filters.size() * sizeof(can_filter)) == 0);
+			rfilters.data(), rfilters.size() * sizeof(can_filter)) == 0);
 
-	delete[] rfilters;		//Deallocate filters
+	if(retVal) {
+		mKernelFilters = rfilters.size();
+	}
 
 	return retVal;
 
 }
 
-bool SocketCanReceiver::receive(CanFrame& canFrame, TimeStamp& timestamp) {
+void SocketCanReceiver::setBusStatistics(const std::shared_ptr<BusStatistics> &statistics) {
+
+	CommonCanReceiver::setBusStatistics(statistics);
+
+	if(statistics) {
+		openStatisticsSocket();
+	} else if(mStatsSock != -1) {
+		close(mStatsSock);
+		mStatsSock = -1;
+	}
+
+}
+
+bool SocketCanReceiver::openStatisticsSocket() {
+
+	if(mStatsSock != -1)		return true;
+
+	sockaddr_can address;
+	socklen_t length = sizeof(address);
+
+	//Same interface as the reception socket
+	if(getsockname(mSock, (sockaddr *)&address, &length) < 0)		return false;
+
+	mStatsSock = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+
+	if(mStatsSock < 0)		return false;
+
+	int fdFrames = 1;
+
+	//Classic frames are still received if the interface does not support FD
+	setsockopt(mStatsSock, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &fdFrames, sizeof(fdFrames));
+
+	if(bind(mStatsSock, (sockaddr *)&address, sizeof(address)) < 0) {
+		close(mStatsSock);
+		mStatsSock = -1;
+		return false;
+	}
+
+	return true;
+
+}
+
+void SocketCanReceiver::drainStatistics() {
+
+	int count;
+
+	do {
+
+		for(unsigned int i = 0; i < SOCKETCAN_RECV_BATCH_SIZE; ++i) {
+
+			mStatsIovs[i].iov_base = &mStatsRawFrames[i];
+			mStatsIovs[i].iov_len = sizeof(canfd_frame);
+
+			msghdr& hdr = mStatsMsgs[i].msg_hdr;
+
+			memset(&hdr, 0, sizeof(hdr));
+			hdr.msg_iov = &mStatsIovs[i];
+			hdr.msg_iovlen = 1;
+
+		}
+
+		count = recvmmsg(mStatsSock, mStatsMsgs, SOCKETCAN_RECV_BATCH_SIZE, MSG_DONTWAIT, NULL);
+
+		if(count <= 0)		return;
+
+		for(int i = 0; i < count; ++i) {
+			copyFrame(mStatsRawFrames[i], mStatsMsgs[i].msg_len, mStatsFrames[i]);
+		}
+
+		if(getBusStatistics())		getBusStatistics()->addFrames(mStatsFrames, count);
+
+	} while(count == SOCKETCAN_RECV_BATCH_SIZE);
+
+}
+
+size_t SocketCanReceiver::optimizeFilters(std::vector<can_filter> &filters) {
+
+	//Only the bits of the id covered by the mask are relevant
+	for(auto iter = filters.begin(); iter != filters.end(); ++iter) {
+		if(!(iter->can_id & CAN_INV_FILTER)) {
+			iter->can_id &= iter->can_mask;
+		}
+	}
+
+	bool changed = true;
+
+	while(changed) {
+
+		changed = false;
+
+		//Remove the filters that are subsumed by another one: a filter whose
+		//mask is a subset of the other mask and whose id matches the other id
+		for(size_t i = 0; i < filters.size(); ++i) {
+
+			if(filters[i].can_id & CAN_INV_FILTER)		continue;
+
+			for(size_t j = 0; j < filters.size(); ) {
+
+				if(i == j || (filters[j].can_id & CAN_INV_FILTER) ||
+						(filters[i].can_mask & ~filters[j].can_mask) ||
+						(filters[j].can_id & filters[i].can_mask) != filters[i].can_id) {
+					++j;
+					continue;
+				}
+
+				filters.erase(filters.begin() + j);
+
+				if(j < i)		--i;
+
+			}
+		}
+
+		//Merge the filters with the same mask whose ids differ in a single bit
+		for(size_t i = 0; i < filters.size(); ++i) {
+
+			if(filters[i].can_id & CAN_INV_FILTER)		continue;
+
+			for(size_t j = i + 1; j < filters.size(); ++j) {
+
+				if((filters[j].can_id & CAN_INV_FILTER) ||
+						filters[i].can_mask != filters[j].can_mask)		continue;
+
+				canid_t diff = filters[i].can_id ^ filters[j].can_id;
+
+				if(diff & (diff - 1))		continue;						//More than one bit differs
+
+				filters[i].can_mask &= ~diff;
+				filters[i].can_id &= ~diff;
+
+				filters.erase(filters.begin() + j);
+
+				changed = true;
+				break;
+
+			}
+		}
+
+	}
+
+	return filters.size();
+
+}
+
+void SocketCanReceiver::parseControlMessages(msghdr *hdr, TimeStamp& timestamp) {
 
 	cmsghdr *cmsg;
+
+	for (cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr,cmsg)) {
+
+		if (cmsg->cmsg_level != SOL_SOCKET)		continue;
+
+		if (cmsg->cmsg_type == SO_TIMESTAMP && mTimeStamp) {
+
+			timeval *stamp = (timeval*)(CMSG_DATA(cmsg));
+
+			timestamp = TimeStamp::fromNanoSec((s64)stamp->tv_sec * 1000000000 + (s64)stamp->tv_usec * 1000);
+
+		} else if (cmsg->cmsg_type == SO_TIMESTAMPING && mTimeStamp) {
+
+			timespec *stamp = (struct timespec *)CMSG_DATA(cmsg);
+
+			//stamp[0] is the software timestamp and stamp[2] the raw hardware
+			//one, which is only filled if the driver supports it.
+			const timespec& selected = (mHardwareTimeStamp &&
+					(stamp[2].tv_sec || stamp[2].tv_nsec)) ? stamp[2] : stamp[0];
+
+			timestamp = TimeStamp::fromNanoSec((s64)selected.tv_sec * 1000000000 + selected.tv_nsec);
+
+		} else if (cmsg->cmsg_type == SO_RXQ_OVFL) {
+
+			//Frames dropped by the socket since it was created. The counter
+			//wraps around, the unsigned difference takes care of it.
+			u32 drops;
+			memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+
+			if (drops != mSocketDrops) {
+				addDroppedFrames((u32)(drops - mSocketDrops));
+				mSocketDrops = drops;
+			}
+
+		}
+	}
+
+}
+
+void SocketCanReceiver::copyFrame(const canfd_frame& rawFrame, size_t size, CanFrame& canFrame) {
+
+	canFrame.setExtendedFormat(rawFrame.can_id & CAN_EFF_FLAG);
+	canFrame.setId(rawFrame.can_id & ~CAN_EFF_FLAG);
+
+	//The size of the message tells whether it is a classic or a FD frame
+	canFrame.setFdFormat(size == CANFD_MTU);
+	canFrame.setBitrateSwitch(size == CANFD_MTU && (rawFrame.flags & CANFD_BRS));
+	canFrame.setErrorStateIndicator(size == CANFD_MTU && (rawFrame.flags & CANFD_ESI));
+
+	canFrame.setData(rawFrame.data, rawFrame.len);
+
+}
+
+bool SocketCanReceiver::receive(CanFrame& canFrame, TimeStamp& timestamp) {
+
 	int nbytes;
 
 	iov.iov_len = sizeof(frame);
@@ -102,48 +326,55 @@ bool SocketCanReceiver::receive(CanFrame& canFrame, TimeStamp& timestamp) {
 
 	if(nbytes >= 0) {
 
-		if(mTimeStamp) {			//Timestamp option is enabled
+		parseControlMessages(&msg, timestamp);
 
-			//Extract timestamp
-			for (cmsg = CMSG_FIRSTHDR(&msg);
-				 cmsg && (cmsg->cmsg_level == SOL_SOCKET);
-				 cmsg = CMSG_NXTHDR(&msg,cmsg)) {
-				if (cmsg->cmsg_type == SO_TIMESTAMP) {
+		//Copy Frame
+		copyFrame(frame, nbytes, canFrame);
 
-					timeval *stamp = (timeval*)(CMSG_DATA(cmsg));
+	}
 
-					timestamp.setMicroSec(stamp->tv_usec);
-					timestamp.setSeconds(stamp->tv_sec);
+	return true;
 
-				} else if (cmsg->cmsg_type == SO_TIMESTAMPING) {
+}
 
-					timespec *stamp = (struct timespec *)CMSG_DATA(cmsg);
+size_t SocketCanReceiver::receiveBatch(CanFrame* frames, TimeStamp* tStamps, size_t max) {
 
-					//Take timestamp from software
+	unsigned int vlen = J1939_MIN(max, SOCKETCAN_RECV_BATCH_SIZE);
 
-					timestamp.setSeconds(stamp[0].tv_sec);
-					timestamp.setMicroSec(stamp[0].tv_nsec/1000);
+	if(vlen == 0)			return 0;
 
-				}
-			}
+	for(unsigned int i = 0; i < vlen; ++i) {
 
-		}
+		mBatchIovs[i].iov_base = &mBatchFrames[i];
+		mBatchIovs[i].iov_len = sizeof(canfd_frame);
 
+		msghdr& hdr = mBatchMsgs[i].msg_hdr;
 
-		//Copy Frame
-		canFrame.setExtendedFormat(frame.can_id & CAN_EFF_FLAG);
-		canFrame.setId(frame.can_id & ~CAN_EFF_FLAG);
+		hdr.msg_name = &mBatchAddrs[i];
+		hdr.msg_namelen = sizeof(sockaddr_can);
+		hdr.msg_iov = &mBatchIovs[i];
+		hdr.msg_iovlen = 1;
+		hdr.msg_control = mBatchCtrlMsgs[i];
+		hdr.msg_controllen = SOCKETCAN_CTRLMSG_SIZE;
+		hdr.msg_flags = 0;
 
-		std::string data;
-		data.append((char*)(frame.data), frame.len);
+	}
 
+	//Do not block, the caller already knows that the socket is readable and
+	//only wants to drain what is queued.
+	int count = recvmmsg(mSock, mBatchMsgs, vlen, MSG_DONTWAIT, NULL);
 
-		canFrame.setData(data);
+	if(count <= 0)			return 0;
 
+	for(int i = 0; i < count; ++i) {
+
+		parseControlMessages(&mBatchMsgs[i].msg_hdr, tStamps[i]);
+
+		copyFrame(mBatchFrames[i], mBatchMsgs[i].msg_len, frames[i]);
 
 	}
 
-	return true;
+	return count;
 
 }
 
@@ -0,0 +1,201 @@
+/*
+ * SocketCanRingReceiver.cpp
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/can.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+
+#include <Backends/Sockets/SocketCanReceiver.h>
+#include <Backends/Sockets/SocketCanRingReceiver.h>
+
+using namespace Utils;
+
+namespace Can {
+namespace Sockets {
+
+SocketCanRingReceiver::~SocketCanRingReceiver() {
+
+	close();
+
+}
+
+bool SocketCanRingReceiver::open(const std::string &interface) {
+
+	close();
+
+	unsigned int ifindex = if_nametoindex(interface.c_str());
+
+	if(ifindex == 0)		return false;			//Interface does not exist
+
+	mSock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+
+	if(mSock < 0) {
+		return false;
+	}
+
+	int version = TPACKET_V3;
+
+	if(setsockopt(mSock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+		close();
+		return false;
+	}
+
+	tpacket_req3 req;
+
+	memset(&req, 0, sizeof(req));
+
+	req.tp_block_size = SOCKETCAN_RING_BLOCK_SIZE;
+	req.tp_block_nr = SOCKETCAN_RING_BLOCK_NR;
+	req.tp_frame_size = SOCKETCAN_RING_FRAME_SIZE;
+	req.tp_frame_nr = (SOCKETCAN_RING_BLOCK_SIZE * SOCKETCAN_RING_BLOCK_NR) / SOCKETCAN_RING_FRAME_SIZE;
+	req.tp_retire_blk_tov = SOCKETCAN_RING_RETIRE_TIMEOUT;
+
+	if(setsockopt(mSock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+		close();
+		return false;
+	}
+
+	mRingSize = req.tp_block_size * req.tp_block_nr;
+
+	void *ring = mmap(NULL, mRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, mSock, 0);
+
+	if(ring == MAP_FAILED) {
+		ring = mmap(NULL, mRingSize, PROT_READ | PROT_WRITE, MAP_SHARED, mSock, 0);		//Without locking the pages
+	}
+
+	if(ring == MAP_FAILED) {
+		mRingSize = 0;
+		close();
+		return false;
+	}
+
+	mRing = static_cast<u8 *>(ring);
+
+	//Bind to the interface to only receive its frames
+	sockaddr_ll addr;
+
+	memset(&addr, 0, sizeof(addr));
+
+	addr.sll_family = AF_PACKET;
+	addr.sll_protocol = htons(ETH_P_ALL);
+	addr.sll_ifindex = ifindex;
+
+	if(bind(mSock, (sockaddr *)&addr, sizeof(addr)) < 0) {
+		close();
+		return false;
+	}
+
+	mCurrentBlock = 0;
+	mPacket = nullptr;
+	mRemaining = 0;
+
+	return true;
+
+}
+
+void SocketCanRingReceiver::close() {
+
+	if(mRing) {
+		munmap(mRing, mRingSize);
+		mRing = nullptr;
+		mRingSize = 0;
+	}
+
+	if(mSock != -1) {
+		::close(mSock);
+		mSock = -1;
+	}
+
+}
+
+void SocketCanRingReceiver::releaseBlock() {
+
+	tpacket_block_desc *block = (tpacket_block_desc *)(mRing + mCurrentBlock * SOCKETCAN_RING_BLOCK_SIZE);
+
+	//Give the block back to the kernel once all its frames have been read
+	__atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+
+	mCurrentBlock = (mCurrentBlock + 1) % SOCKETCAN_RING_BLOCK_NR;
+	mPacket = nullptr;
+
+}
+
+bool SocketCanRingReceiver::receive(CanFrame& canFrame, TimeStamp& timestamp) {
+
+	return receiveBatch(&canFrame, &timestamp, 1) == 1;
+
+}
+
+size_t SocketCanRingReceiver::receiveBatch(CanFrame* frames, TimeStamp* tStamps, size_t max) {
+
+	size_t count = 0;
+
+	if(!mRing)		return 0;
+
+	while(count < max) {
+
+		tpacket_block_desc *block = (tpacket_block_desc *)(mRing + mCurrentBlock * SOCKETCAN_RING_BLOCK_SIZE);
+
+		if(!mPacket) {
+
+			u32 status = __atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE);
+
+			if(!(status & TP_STATUS_USER)) {
+				break;			//The kernel has not handed the block yet
+			}
+
+			if(status & TP_STATUS_LOSING) {
+				//The ring was full at some point. The statistics are reset
+				//every time they are read.
+				tpacket_stats_v3 stats;
+				socklen_t length = sizeof(stats);
+
+				if(getsockopt(mSock, SOL_PACKET, PACKET_STATISTICS, &stats, &length) == 0 && stats.tp_drops) {
+					addDroppedFrames(stats.tp_drops);
+				}
+			}
+
+			mPacket = (tpacket3_hdr *)((u8 *)block + block->hdr.bh1.offset_to_first_pkt);
+			mRemaining = block->hdr.bh1.num_pkts;
+		}
+
+		while(count < max && mRemaining > 0) {
+
+			const sockaddr_ll *addr = (const sockaddr_ll *)((u8 *)mPacket + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+
+			//Skip the frames sent from this host, as the raw sockets do, and anything that is not a CAN frame
+			if(addr->sll_pkttype != PACKET_OUTGOING &&
+					(mPacket->tp_snaplen == CAN_MTU || mPacket->tp_snaplen == CANFD_MTU)) {
+
+				const canfd_frame *rawFrame = (const canfd_frame *)((u8 *)mPacket + mPacket->tp_mac);
+
+				SocketCanReceiver::copyFrame(*rawFrame, mPacket->tp_snaplen, frames[count]);
+
+				tStamps[count] = TimeStamp::fromNanoSec((s64)mPacket->tp_sec * 1000000000 + mPacket->tp_nsec);
+
+				++count;
+			}
+
+			mPacket = (tpacket3_hdr *)((u8 *)mPacket + mPacket->tp_next_offset);
+			--mRemaining;
+		}
+
+		if(mRemaining == 0) {
+			releaseBlock();
+		}
+
+	}
+
+	return count;
+
+}
+
+} /* namespace Sockets */
+} /* namespace Can */
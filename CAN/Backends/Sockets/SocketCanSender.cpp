@@ -11,11 +11,17 @@
 #include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
 #include <net/if.h>
 #include <linux/can.h>
 #include <linux/can/raw.h>
 
+#include <deque>
+#include <utility>
+
 #include <Utils.h>
 
 #include <Backends/Sockets/SocketCanSender.h>
@@ -23,32 +29,347 @@
 namespace Can {
 namespace Sockets {
 
-SocketCanSender::SocketCanSender(int sock) : mSock(sock) {
+struct SocketCanSender::TxQueue {
+	std::mutex lock;
+	std::condition_variable pending;		//Frames queued or finishing
+	std::condition_variable space;			//Room in the queue
+
+	std::deque<CanFrame> frames[SOCKETCAN_TX_PRIORITIES];
+	size_t depth = 0;
+	size_t capacity = SOCKETCAN_TX_QUEUE_SIZE;
+	TxPolicy policy = DROP_OLDEST;
+
+	u64 sent = 0;
+	u64 dropped = 0;
+	u64 retries = 0;
+
+	//Errors to be notified once the lock is released
+	std::vector<std::pair<CanFrame, int>> errors;
+
+	bool finished = false;
+	std::thread thread;
+};
+
+SocketCanSender::SocketCanSender(int sock) : mSock(sock), mTxQueue(new TxQueue) {
+
+	mTxQueue->thread = std::thread(&SocketCanSender::runTxQueue, this);
 
 }
 
 SocketCanSender::~SocketCanSender() {
+
+	//Stop the queue first, the scheduler could be blocked waiting for room
+	{
+		std::lock_guard<std::mutex> lock(mTxQueue->lock);
+		mTxQueue->finished = true;
+	}
+
+	mTxQueue->pending.notify_all();
+	mTxQueue->space.notify_all();
+
 	finalize();
+
+	mTxQueue->thread.join();
+}
+
+u8 SocketCanSender::getPriority(const CanFrame& frame) {
+
+	return frame.isExtendedFormat() ? ((frame.getId() >> 26) & 0x07) : ((frame.getId() >> 8) & 0x07);
+
+}
+
+void SocketCanSender::setTxPolicy(TxPolicy policy) {
+
+	std::lock_guard<std::mutex> lock(mTxQueue->lock);
+	mTxQueue->policy = policy;
+
+}
+
+void SocketCanSender::setTxQueueSize(size_t size) {
+
+	std::lock_guard<std::mutex> lock(mTxQueue->lock);
+	mTxQueue->capacity = J1939_MAX(size, 1);
+
+}
+
+SocketCanSender::TxStats SocketCanSender::getTxStats() const {
+
+	std::lock_guard<std::mutex> lock(mTxQueue->lock);
+
+	TxStats stats;
+
+	stats.depth = mTxQueue->depth;
+	stats.sent = mTxQueue->sent;
+	stats.dropped = mTxQueue->dropped;
+	stats.retries = mTxQueue->retries;
+
+	return stats;
+
+}
+
+/*
+ * Fills the raw frame and returns the number of bytes to be written, which
+ * tells the kernel whether it is a classic or a FD frame.
+ */
+static size_t toRawFrame(const CanFrame& frame, canfd_frame& rawFrame) {
+
+	memset(&rawFrame, 0, sizeof(canfd_frame));
+
+	rawFrame.can_id = frame.getId();
+	rawFrame.can_id |= (frame.isExtendedFormat() ? CAN_EFF_FLAG : 0);
+	rawFrame.len = frame.getDataLength();
+
+	memcpy(rawFrame.data, frame.getRawData(), rawFrame.len);
+
+	if(!frame.isFdFormat()) {
+		return CAN_MTU;
+	}
+
+	rawFrame.flags |= (frame.isBitrateSwitch() ? CANFD_BRS : 0);
+	rawFrame.flags |= (frame.isErrorStateIndicator() ? CANFD_ESI : 0);
+
+	//Pad up to the next valid FD length
+	rawFrame.len = CanFrame::dlcToLength(CanFrame::lengthToDlc(rawFrame.len));
+
+	return CANFD_MTU;
+
 }
 
 void SocketCanSender::_sendFrame(const CanFrame& frame) const {
 
-	int retval;
+	_sendFrames(&frame, 1);
 
-	struct can_frame frameToSend;
-	memset(&frameToSend, 0, sizeof(can_frame));
+}
 
-	frameToSend.can_id = frame.getId();
-	frameToSend.can_id |= (frame.isExtendedFormat() ? CAN_EFF_FLAG : 0);
-	frameToSend.can_dlc = frame.getData().size();
+size_t SocketCanSender::sendRaw(const CanFrame* frames, size_t count, int &error) const {
 
-	memcpy(frameToSend.data, frame.getData().c_str(), frameToSend.can_dlc);
+	canfd_frame rawFrames[SOCKETCAN_SEND_BATCH_SIZE];
+	iovec iovs[SOCKETCAN_SEND_BATCH_SIZE];
+	mmsghdr msgs[SOCKETCAN_SEND_BATCH_SIZE];
+
+	size_t sent = 0;
+
+	while(sent < count) {
+
+		unsigned int vlen = J1939_MIN(count - sent, SOCKETCAN_SEND_BATCH_SIZE);
+
+		memset(msgs, 0, vlen * sizeof(mmsghdr));
+
+		for(unsigned int i = 0; i < vlen; ++i) {
+
+			iovs[i].iov_base = &rawFrames[i];
+			iovs[i].iov_len = toRawFrame(frames[sent + i], rawFrames[i]);
+
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+
+		}
+
+		//The socket is already bound, no need to specify the destination.
+		//Never block, the frames that do not fit are queued.
+		int retval = sendmmsg(mSock, msgs, vlen, MSG_DONTWAIT);
+
+		if(retval < 0) {
+			error = errno;
+			break;
+		}
+
+		sent += retval;
+
+	}
+
+	return sent;
+
+}
+
+static bool isSocketFull(int error) {
+
+	return error == EAGAIN || error == EWOULDBLOCK || error == ENOBUFS;
+
+}
+
+size_t SocketCanSender::_sendFrames(const CanFrame* frames, size_t count) const {
+
+	std::unique_lock<std::mutex> lock(mTxQueue->lock);
+
+	size_t pos = 0;
+	size_t accepted = 0;		//Written to the socket or queued
+
+	//Write directly while nothing is waiting in the queue, otherwise the
+	//frames would overtake the queued ones
+	while(pos < count && mTxQueue->depth == 0) {
+
+		int error = 0;
+		size_t sent = sendRaw(frames + pos, count - pos, error);
+
+		mTxQueue->sent += sent;
+		pos += sent;
+		accepted += sent;
+
+		if(pos == count || isSocketFull(error))		break;
+
+		//Not a matter of space, the frame cannot be sent
+		mTxQueue->errors.push_back(std::make_pair(frames[pos], error));
+		++pos;
+
+	}
+
+	for(; pos < count; ++pos) {
+		if(enqueue(lock, frames[pos]))		++accepted;
+	}
+
+	if(mTxQueue->depth > 0) {
+		mTxQueue->pending.notify_one();
+	}
+
+	notifyErrors(lock);
+
+	return accepted;
+
+}
+
+bool SocketCanSender::enqueue(std::unique_lock<std::mutex> &lock, const CanFrame& frame) const {
+
+	TxQueue &queue = *mTxQueue;
+
+	u8 priority = getPriority(frame);
+
+	while(queue.depth >= queue.capacity) {
+
+		//Lowest priority with queued frames
+		u8 lowest = SOCKETCAN_TX_PRIORITIES - 1;
+
+		while(queue.frames[lowest].empty())		--lowest;
+
+		if(lowest > priority) {
+
+			//Lower priority frames yield to this one. The newest one goes.
+			queue.errors.push_back(std::make_pair(queue.frames[lowest].back(), ENOBUFS));
+			queue.frames[lowest].pop_back();
+
+		} else if(queue.policy == DROP_OLDEST && lowest == priority) {
+
+			queue.errors.push_back(std::make_pair(queue.frames[lowest].front(), ENOBUFS));
+			queue.frames[lowest].pop_front();
+
+		} else if(queue.policy == BLOCK && !queue.finished) {
+
+			queue.space.wait(lock);
+			continue;
+
+		} else {
+
+			//Only frames with higher priority queued, or dropping the newest
+			queue.errors.push_back(std::make_pair(frame, ENOBUFS));
+			++queue.dropped;
+			return false;
+
+		}
+
+		--queue.depth;
+		++queue.dropped;
+
+	}
+
+	queue.frames[priority].push_back(frame);
+	++queue.depth;
+
+	return true;
+
+}
+
+void SocketCanSender::notifyErrors(std::unique_lock<std::mutex> &lock) const {
+
+	if(mTxQueue->errors.empty())		return;
+
+	std::vector<std::pair<CanFrame, int>> errors;
+
+	errors.swap(mTxQueue->errors);
+
+	//The callback may send frames
+	lock.unlock();
+
+	for(auto iter = errors.begin(); iter != errors.end(); ++iter) {
+		notifySendError(iter->first, iter->second);
+	}
+
+	lock.lock();
+
+}
+
+void SocketCanSender::runTxQueue() {
+
+	TxQueue &queue = *mTxQueue;
+
+	std::vector<CanFrame> batch;
+
+	batch.reserve(SOCKETCAN_SEND_BATCH_SIZE);
+
+	std::unique_lock<std::mutex> lock(queue.lock);
+
+	while(!queue.finished) {
+
+		if(queue.depth == 0) {
+			queue.pending.wait(lock);
+			continue;
+		}
+
+		//Take the frames with higher priority first, as the bus would do
+		batch.clear();
+
+		for(size_t i = 0; i < SOCKETCAN_TX_PRIORITIES && batch.size() < SOCKETCAN_SEND_BATCH_SIZE; ++i) {
+			for(auto frame = queue.frames[i].begin(); frame != queue.frames[i].end() &&
+					batch.size() < SOCKETCAN_SEND_BATCH_SIZE; ++frame) {
+				batch.push_back(*frame);
+			}
+		}
+
+		//The lock is kept while writing, so that the queue does not change
+		//under our feet. The socket is not blocking.
+		int error = 0;
+		size_t sent = sendRaw(batch.data(), batch.size(), error);
+
+		size_t done = sent;
+
+		if(sent < batch.size() && !isSocketFull(error)) {
+			queue.errors.push_back(std::make_pair(batch[sent], error));
+			++done;			//Not retried
+		}
+
+		queue.sent += sent;
+		queue.depth -= done;
+
+		for(size_t i = 0; done > 0; ++i) {
+			size_t removed = J1939_MIN(done, queue.frames[i].size());
+
+			queue.frames[i].erase(queue.frames[i].begin(), queue.frames[i].begin() + removed);
+			done -= removed;
+		}
+
+		queue.space.notify_all();
+
+		notifyErrors(lock);
+
+		if(sent < batch.size() && isSocketFull(error)) {
+
+			++queue.retries;
+
+			lock.unlock();
+
+			if(error == ENOBUFS) {
+				poll(NULL, 0, SOCKETCAN_TX_RETRY_TIMEOUT);
+			} else {
+				pollfd fd;
+				fd.fd = mSock;
+				fd.events = POLLOUT;
+
+				poll(&fd, 1, SOCKETCAN_TX_POLL_TIMEOUT);		//Socket buffer full, wait until there is room
+			}
+
+			lock.lock();
+
+		}
 
-	retval = write(mSock, &frameToSend, sizeof(struct can_frame));
-	if (retval != sizeof(struct can_frame))
-	{
-		printf("[SocketCanSender::_sendFrame] retval: %d, error: %s\n",
-			retval, strerror(errno));
 	}
 
 }
@@ -0,0 +1,103 @@
+/*
+ * VirtualCanBus.cpp
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <BusStatistics.h>
+
+#include <Backends/Virtual/VirtualCanBus.h>
+#include <Backends/Virtual/VirtualCanReceiver.h>
+
+using namespace Utils;
+
+namespace Can
+{
+namespace Virtual
+{
+std::mutex VirtualCanBus::mBusesLock;
+std::map<std::string, std::shared_ptr<VirtualCanBus>> VirtualCanBus::mBuses;
+
+std::shared_ptr<VirtualCanBus> VirtualCanBus::getBus(const std::string &name)
+{
+	std::lock_guard<std::mutex> lock(mBusesLock);
+
+	std::shared_ptr<VirtualCanBus> &bus = mBuses[name];
+
+	if (!bus) {
+		bus = std::make_shared<VirtualCanBus>();
+	}
+
+	return bus;
+}
+
+void VirtualCanBus::attach(VirtualCanReceiver *receiver)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mReceivers.push_back(receiver);
+}
+
+void VirtualCanBus::detach(VirtualCanReceiver *receiver)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mReceivers.erase(
+		std::remove(mReceivers.begin(), mReceivers.end(), receiver),
+		mReceivers.end());
+}
+
+void VirtualCanBus::deliver(const CanFrame *frames, size_t count,
+							const TimeStamp &tStamp)
+{
+	for (auto receiver = mReceivers.begin(); receiver != mReceivers.end();
+		 ++receiver) {
+		(*receiver)->deliver(frames, count, tStamp);
+	}
+}
+
+size_t VirtualCanBus::transmit(const CanFrame *frames, size_t count)
+{
+	if (!mPacing || mBitrate == 0) {
+		std::lock_guard<std::mutex> lock(mLock);
+
+		deliver(frames, count, TimeStamp::now());
+		return count;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		TimeStamp end;
+
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+
+			// The frame starts when the bus is idle and is received once it
+			// has been completely transmitted
+			TimeStamp now = TimeStamp::now();
+			TimeStamp start = (mIdleTime > now ? mIdleTime : now);
+
+			end = TimeStamp::fromNanoSec(
+				start.getNanoSec() +
+				(s64)BusStatistics::getFrameBits(frames[i]) * 1000000000 /
+					mBitrate);
+
+			mIdleTime = end;
+		}
+
+		// TimeStamp::now() counts from the epoch of the steady clock
+		std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::nanoseconds(end.getNanoSec()))));
+
+		std::lock_guard<std::mutex> lock(mLock);
+
+		deliver(&frames[i], 1, end);
+	}
+
+	return count;
+}
+
+} /* namespace Virtual */
+} /* namespace Can */
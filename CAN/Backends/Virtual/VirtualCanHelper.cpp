@@ -0,0 +1,50 @@
+/*
+ * VirtualCanHelper.cpp
+ */
+
+#include <Backends/Virtual/VirtualCanHelper.h>
+#include <Backends/Virtual/VirtualCanReceiver.h>
+#include <Backends/Virtual/VirtualCanSender.h>
+
+namespace Can
+{
+namespace Virtual
+{
+size_t VirtualCanHelper::mNumberOfIfaces = 0;
+bool VirtualCanHelper::mPacing = false;
+
+std::set<std::string> VirtualCanHelper::getCanIfaces()
+{
+	std::set<std::string> retVal;
+
+	for (size_t i = 0; i < mNumberOfIfaces; ++i) {
+		retVal.insert(VIRTUALCAN_IFACE_PREFIX + std::to_string(i));
+	}
+
+	return retVal;
+}
+
+bool VirtualCanHelper::initialize(std::string interface, u32 bitrate)
+{
+	mBus = VirtualCanBus::getBus(interface);
+
+	mBus->setBitrate(bitrate);
+	mBus->setPacing(mPacing);
+
+	return true;
+}
+
+void VirtualCanHelper::finalize() { mBus.reset(); }
+
+ICanSender *VirtualCanHelper::allocateCanSender()
+{
+	return new VirtualCanSender(mBus);
+}
+
+CommonCanReceiver *VirtualCanHelper::allocateCanReceiver()
+{
+	return new VirtualCanReceiver(mBus);
+}
+
+} /* namespace Virtual */
+} /* namespace Can */
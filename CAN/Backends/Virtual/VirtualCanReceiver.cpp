@@ -0,0 +1,93 @@
+/*
+ * VirtualCanReceiver.cpp
+ */
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <Backends/Virtual/VirtualCanReceiver.h>
+
+using namespace Utils;
+
+namespace Can
+{
+namespace Virtual
+{
+VirtualCanReceiver::VirtualCanReceiver(std::shared_ptr<VirtualCanBus> bus)
+	: mBus(bus)
+{
+	mEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	mBus->attach(this);
+}
+
+VirtualCanReceiver::~VirtualCanReceiver()
+{
+	mBus->detach(this);
+
+	if (mEventFd != -1)
+		close(mEventFd);
+}
+
+void VirtualCanReceiver::deliver(const CanFrame *frames, size_t count,
+								 const TimeStamp &tStamp)
+{
+	size_t dropped = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+
+		for (size_t i = 0; i < count; ++i) {
+			if (mQueue.size() >= VIRTUALCAN_RX_QUEUE_SIZE) {
+				++dropped;
+				continue;
+			}
+
+			mQueue.push_back(std::make_pair(frames[i], tStamp));
+		}
+	}
+
+	// Frames dropped because the queue was full
+	if (dropped > 0)
+		addDroppedFrames(dropped);
+
+	const u64 pending = 1;
+
+	// Only fails if the counter overflows, in which case the receiver is
+	// readable anyway
+	ssize_t written = write(mEventFd, &pending, sizeof(pending));
+	(void)written;
+}
+
+bool VirtualCanReceiver::receive(CanFrame &frame, TimeStamp &tStamp)
+{
+	return receiveBatch(&frame, &tStamp, 1) == 1;
+}
+
+size_t VirtualCanReceiver::receiveBatch(CanFrame *frames, TimeStamp *tStamps,
+										size_t max)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	size_t count = 0;
+
+	while (count < max && !mQueue.empty()) {
+		frames[count] = mQueue.front().first;
+		tStamps[count] = mQueue.front().second;
+		mQueue.pop_front();
+		++count;
+	}
+
+	if (mQueue.empty()) {
+		// Nothing else pending, reset the counter of the eventfd. The frames
+		// delivered from now on make it readable again.
+		u64 value;
+		ssize_t rd = read(mEventFd, &value, sizeof(value));
+		(void)rd;
+	}
+
+	return count;
+}
+
+} /* namespace Virtual */
+} /* namespace Can */
@@ -0,0 +1,30 @@
+/*
+ * VirtualCanSender.cpp
+ */
+
+#include <Backends/Virtual/VirtualCanSender.h>
+
+namespace Can
+{
+namespace Virtual
+{
+VirtualCanSender::VirtualCanSender(std::shared_ptr<VirtualCanBus> bus)
+	: mBus(bus)
+{
+}
+
+VirtualCanSender::~VirtualCanSender() { finalize(); }
+
+void VirtualCanSender::_sendFrame(const CanFrame &frame) const
+{
+	mBus->transmit(&frame, 1);
+}
+
+size_t VirtualCanSender::_sendFrames(const CanFrame *frames,
+									 size_t count) const
+{
+	return mBus->transmit(frames, count);
+}
+
+} /* namespace Virtual */
+} /* namespace Can */
@@ -0,0 +1,348 @@
+/*
+ * BinaryCaptureReader.cpp
+ */
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "BinaryCaptureReader.h"
+
+namespace Can
+{
+BinaryCaptureReader::BinaryCaptureReader()
+	: mTotalFrames(0), mBlock(0), mRecord(nullptr), mRecordsEnd(nullptr),
+	  mRemainingFrames(0), mTime(0), mNextPos(0), mCurrentPos(0),
+	  mLastInterface(0)
+{
+}
+
+BinaryCaptureReader::BinaryCaptureReader(const std::string &path)
+	: BinaryCaptureReader()
+{
+	loadFile(path);
+}
+
+BinaryCaptureReader::~BinaryCaptureReader() {}
+
+bool BinaryCaptureReader::loadFile(const std::string &path)
+{
+	unloadFile();
+
+	mFileName = path;
+
+	if (!mFile.open(path) || mFile.size() < BIN_CAPTURE_MAGIC_SIZE ||
+		memcmp(mFile.data(), BIN_CAPTURE_MAGIC, BIN_CAPTURE_MAGIC_SIZE) != 0) {
+		unloadFile();
+		return false;
+	}
+
+	if (!loadIndex()) {
+		mIndex.clear();
+		mInterfaces.clear();
+		findBlocks();
+	}
+
+	reset();
+
+	return true;
+}
+
+void BinaryCaptureReader::unloadFile()
+{
+	mFile.close();
+
+	mFileName.clear();
+	mIndex.clear();
+	mInterfaces.clear();
+	mTotalFrames = 0;
+
+	reset();
+}
+
+bool BinaryCaptureReader::loadIndex()
+{
+	BinaryCaptureFooter footer;
+
+	if (mFile.size() < BIN_CAPTURE_MAGIC_SIZE + sizeof(footer)) {
+		return false;
+	}
+
+	size_t indexEnd = mFile.size() - sizeof(footer);
+
+	memcpy(&footer, mFile.data() + indexEnd, sizeof(footer));
+
+	if (memcmp(footer.magic, BIN_CAPTURE_FOOTER_MAGIC,
+			   BIN_CAPTURE_MAGIC_SIZE) != 0 ||
+		footer.indexOffset < BIN_CAPTURE_MAGIC_SIZE ||
+		footer.indexOffset > indexEnd ||
+		footer.blocks > (indexEnd - footer.indexOffset) /
+							sizeof(BinaryCaptureIndexEntry)) {
+		return false;
+	}
+
+	mIndex.resize(footer.blocks);
+
+	if (!mIndex.empty()) {
+		memcpy(mIndex.data(), mFile.data() + footer.indexOffset,
+			   mIndex.size() * sizeof(BinaryCaptureIndexEntry));
+	}
+
+	// The entries must match the blocks
+	u64 position = 0;
+
+	for (auto entry = mIndex.begin(); entry != mIndex.end(); ++entry) {
+		const BinaryCaptureBlock &block = entry->block;
+
+		if (entry->offset < BIN_CAPTURE_MAGIC_SIZE ||
+			entry->offset > footer.indexOffset ||
+			footer.indexOffset - entry->offset < sizeof(block) ||
+			block.size > footer.indexOffset - entry->offset - sizeof(block) ||
+			block.magic != BIN_CAPTURE_BLOCK_MAGIC || block.frames == 0 ||
+			block.position != position ||
+			memcmp(&block, mFile.data() + entry->offset, sizeof(block)) != 0) {
+			return false;
+		}
+
+		position += block.frames;
+	}
+
+	if (position != footer.frames) {
+		return false;
+	}
+
+	// Followed by the names of the interfaces
+	const char *pos = mFile.data() + footer.indexOffset +
+					  mIndex.size() * sizeof(BinaryCaptureIndexEntry);
+	const char *end = mFile.data() + indexEnd;
+	u32 interfaces;
+
+	if ((size_t)(end - pos) < sizeof(interfaces)) {
+		return false;
+	}
+
+	memcpy(&interfaces, pos, sizeof(interfaces));
+	pos += sizeof(interfaces);
+
+	if (interfaces > BIN_CAPTURE_MAX_INTERFACES) {
+		return false;
+	}
+
+	for (u32 i = 0; i < interfaces; ++i) {
+		if (pos == end || end - pos - 1 < (u8)*pos) {
+			return false;
+		}
+
+		u8 length = *pos++;
+
+		mInterfaces.push_back(std::string(pos, length));
+		pos += length;
+	}
+
+	mTotalFrames = position;
+
+	return pos == end;
+}
+
+void BinaryCaptureReader::findBlocks()
+{
+	size_t offset = BIN_CAPTURE_MAGIC_SIZE;
+	u64 position = 0;
+	BinaryCaptureBlock block;
+
+	// Up to the first incomplete block
+	while (mFile.size() - offset >= sizeof(block)) {
+		memcpy(&block, mFile.data() + offset, sizeof(block));
+
+		if (block.magic != BIN_CAPTURE_BLOCK_MAGIC || block.frames == 0 ||
+			block.position != position ||
+			block.size > mFile.size() - offset - sizeof(block)) {
+			break;
+		}
+
+		mIndex.push_back({offset, block});
+
+		position += block.frames;
+		offset += sizeof(block) + block.size;
+	}
+
+	mTotalFrames = position;
+}
+
+void BinaryCaptureReader::reset()
+{
+	mCurrentPos = 0;
+	mLastInterface = 0;
+	mLastReadFrameTimePair.first = Utils::TimeStamp();
+	mLastReadFrameTimePair.second.clear();
+
+	if (!mIndex.empty()) {
+		enterBlock(0);
+		return;
+	}
+
+	mBlock = 0;
+	mRecord = mRecordsEnd = nullptr;
+	mRemainingFrames = 0;
+	mTime = 0;
+	mNextPos = 0;
+}
+
+void BinaryCaptureReader::enterBlock(size_t block)
+{
+	const BinaryCaptureIndexEntry &entry = mIndex[block];
+
+	mBlock = block;
+	mRecord = (const u8 *)mFile.data() + entry.offset + sizeof(entry.block);
+	mRecordsEnd = mRecord + entry.block.size;
+	mRemainingFrames = entry.block.frames;
+	mTime = entry.block.firstTime;
+	mNextPos = entry.block.position;
+}
+
+bool BinaryCaptureReader::readRecord()
+{
+	const u8 *pos = mRecord;
+	s64 delta;
+	u32 id;
+
+	if (!BinaryCapture::readVarint(pos, mRecordsEnd, delta) ||
+		(size_t)(mRecordsEnd - pos) < sizeof(id) + 1) {
+		return false;
+	}
+
+	memcpy(&id, pos, sizeof(id));
+	pos += sizeof(id);
+
+	u8 info = *pos++;
+	u8 flags = info & 0x0F;
+
+	CanFrame &frame = mLastReadFrameTimePair.second;
+
+	frame.setFdFormat(flags & BIN_CAPTURE_FLAG_FD);
+
+	size_t length = CanFrame::dlcToLength(info >> 4);
+
+	if (length > frame.getMaxDataLength() ||
+		(size_t)(mRecordsEnd - pos) < length) {
+		return false;
+	}
+
+	memcpy(frame.getRawData(), pos, length);
+	frame.setDataLength(length);
+
+	frame.setExtendedFormat(flags & BIN_CAPTURE_FLAG_EXTENDED);
+	frame.setId(id & BIN_CAPTURE_ID_MASK);
+	frame.setBitrateSwitch(flags & BIN_CAPTURE_FLAG_BRS);
+	frame.setErrorStateIndicator(flags & BIN_CAPTURE_FLAG_ESI);
+
+	mTime += delta;
+	mLastReadFrameTimePair.first = Utils::TimeStamp::fromNanoSec(mTime);
+	mLastInterface = id >> BIN_CAPTURE_INTERFACE_SHIFT;
+
+	mRecord = pos + length;
+	--mRemainingFrames;
+	mCurrentPos = mNextPos++;
+
+	return true;
+}
+
+void BinaryCaptureReader::readNextCanFrame()
+{
+	if (isEndOfFile()) {
+		// Nothing else to read, as an empty line in the TRC files
+		mLastReadFrameTimePair.first = Utils::TimeStamp();
+		mLastReadFrameTimePair.second.clear();
+		return;
+	}
+
+	if (mRemainingFrames == 0) {
+		enterBlock(mBlock + 1);
+	}
+
+	if (!readRecord()) {
+		throw BinaryCaptureReadException();
+	}
+}
+
+template <typename Predicate>
+bool BinaryCaptureReader::readUntil(Predicate predicate)
+{
+	while (!isEndOfFile()) {
+		try {
+			readNextCanFrame();
+		} catch (BinaryCaptureReadException &) {
+			return false;
+		}
+
+		if (predicate(mCurrentPos,
+					  mLastReadFrameTimePair.first.getNanoSec())) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool BinaryCaptureReader::seekPosition(size_t pos)
+{
+	if (!isFileLoaded() || pos >= mTotalFrames) {
+		return false;
+	}
+
+	if (mNextPos == pos + 1 && mCurrentPos == pos) {
+		return true;
+	}
+
+	auto entry = std::upper_bound(
+		mIndex.begin(), mIndex.end(), pos,
+		[](size_t pos, const BinaryCaptureIndexEntry &entry) {
+			return pos < entry.block.position;
+		});
+
+	size_t block = (entry - mIndex.begin()) - 1;
+
+	// Going on from the last frame read if it is in the same block
+	if (block != mBlock || mNextPos > pos) {
+		enterBlock(block);
+	}
+
+	return readUntil([pos](size_t position, s64) { return position == pos; });
+}
+
+bool BinaryCaptureReader::seekTime(const Utils::TimeStamp &tStamp)
+{
+	if (!isFileLoaded()) {
+		return false;
+	}
+
+	s64 time = tStamp.getNanoSec();
+
+	// First block which is not earlier than the time
+	auto entry = std::lower_bound(
+		mIndex.begin(), mIndex.end(), time,
+		[](const BinaryCaptureIndexEntry &entry, s64 time) {
+			return entry.block.lastTime < time;
+		});
+
+	if (entry == mIndex.end()) {
+		return false;
+	}
+
+	enterBlock(entry - mIndex.begin());
+
+	return readUntil(
+		[time](size_t, s64 frameTime) { return frameTime >= time; });
+}
+
+std::pair<Utils::TimeStamp, CanFrame> BinaryCaptureReader::getLastCanFrame()
+{
+	return mLastReadFrameTimePair;
+}
+
+std::string BinaryCaptureReader::getInterfaceName(u8 interface) const
+{
+	return interface < mInterfaces.size() ? mInterfaces[interface] : "";
+}
+
+} /* namespace Can */
@@ -0,0 +1,197 @@
+/*
+ * BinaryCaptureWriter.cpp
+ */
+
+#include <string.h>
+
+#include "BinaryCaptureWriter.h"
+
+namespace Can
+{
+BinaryCaptureWriter::BinaryCaptureWriter()
+	: mFile(nullptr), mOffset(0), mLastTime(0), mFrames(0)
+{
+	memset(&mBlock, 0, sizeof(mBlock));
+}
+
+BinaryCaptureWriter::BinaryCaptureWriter(const std::string &file)
+	: BinaryCaptureWriter()
+{
+	open(file);
+}
+
+BinaryCaptureWriter::~BinaryCaptureWriter() { close(); }
+
+void BinaryCaptureWriter::write(const CanFrame &frame,
+								const Utils::TimeStamp &timeStamp,
+								u8 interface)
+{
+	if (!mFile || interface >= BIN_CAPTURE_MAX_INTERFACES) {
+		throw BinaryCaptureWriteException();
+	}
+
+	if (mRecords.size() + BIN_CAPTURE_MAX_RECORD_SIZE > BIN_CAPTURE_BLOCK_SIZE &&
+		!flush()) {
+		throw BinaryCaptureWriteException();
+	}
+
+	s64 time = timeStamp.getNanoSec();
+
+	if (mBlock.frames == 0) {
+		mBlock.position = mFrames;
+		mBlock.firstTime = mLastTime = time;
+	}
+
+	u8 dlc = CanFrame::lengthToDlc(frame.getDataLength());
+	size_t length = frame.isFdFormat() ? CanFrame::dlcToLength(dlc)
+									   : frame.getDataLength();
+
+	u32 id = (frame.getId() & BIN_CAPTURE_ID_MASK) |
+			 ((u32)interface << BIN_CAPTURE_INTERFACE_SHIFT);
+
+	u8 flags = (frame.isExtendedFormat() ? BIN_CAPTURE_FLAG_EXTENDED : 0) |
+			   (frame.isFdFormat() ? BIN_CAPTURE_FLAG_FD : 0) |
+			   (frame.isBitrateSwitch() ? BIN_CAPTURE_FLAG_BRS : 0) |
+			   (frame.isErrorStateIndicator() ? BIN_CAPTURE_FLAG_ESI : 0);
+
+	size_t offset = mRecords.size();
+
+	mRecords.resize(offset + BIN_CAPTURE_MAX_RECORD_SIZE);
+
+	u8 *pos = mRecords.data() + offset;
+
+	pos += BinaryCapture::writeVarint(pos, time - mLastTime);
+
+	memcpy(pos, &id, sizeof(id));
+	pos += sizeof(id);
+
+	*pos++ = flags | (dlc << 4);
+
+	memcpy(pos, frame.getRawData(), frame.getDataLength());
+	memset(pos + frame.getDataLength(), 0, length - frame.getDataLength());
+	pos += length;
+
+	mRecords.resize(pos - mRecords.data());
+
+	mLastTime = time;
+
+	mBlock.lastTime = time;
+	mBlock.interfaces |= (1 << interface);
+	++mBlock.frames;
+	++mFrames;
+}
+
+bool BinaryCaptureWriter::setInterface(u8 interface, const std::string &name)
+{
+	if (interface >= BIN_CAPTURE_MAX_INTERFACES || name.size() > 0xFF) {
+		return false;
+	}
+
+	if (mInterfaces.size() <= interface) {
+		mInterfaces.resize(interface + 1);
+	}
+
+	mInterfaces[interface] = name;
+
+	return true;
+}
+
+bool BinaryCaptureWriter::flush()
+{
+	if (!mFile) {
+		return false;
+	}
+
+	if (mBlock.frames == 0) {
+		return true;
+	}
+
+	mBlock.magic = BIN_CAPTURE_BLOCK_MAGIC;
+	mBlock.size = mRecords.size();
+
+	bool written =
+		fwrite(&mBlock, sizeof(mBlock), 1, mFile) == 1 &&
+		fwrite(mRecords.data(), mRecords.size(), 1, mFile) == 1 &&
+		fflush(mFile) == 0;
+
+	if (!written) {
+		return false;
+	}
+
+	mIndex.push_back({mOffset, mBlock});
+	mOffset += sizeof(mBlock) + mRecords.size();
+
+	memset(&mBlock, 0, sizeof(mBlock));
+	mRecords.clear();
+
+	return true;
+}
+
+bool BinaryCaptureWriter::open(const std::string &file)
+{
+	close();
+
+	mFile = fopen(file.c_str(), "wb");
+
+	if (!mFile) {
+		return false;
+	}
+
+	if (fwrite(BIN_CAPTURE_MAGIC, BIN_CAPTURE_MAGIC_SIZE, 1, mFile) != 1) {
+		close();
+		return false;
+	}
+
+	mOffset = BIN_CAPTURE_MAGIC_SIZE;
+	mRecords.reserve(BIN_CAPTURE_BLOCK_SIZE);
+
+	return true;
+}
+
+void BinaryCaptureWriter::close()
+{
+	if (mFile && flush()) {
+		BinaryCaptureFooter footer;
+
+		footer.indexOffset = mOffset;
+		footer.blocks = mIndex.size();
+		footer.frames = mFrames;
+		memcpy(footer.magic, BIN_CAPTURE_FOOTER_MAGIC, BIN_CAPTURE_MAGIC_SIZE);
+
+		u32 interfaces = mInterfaces.size();
+		bool written =
+			(mIndex.empty() || fwrite(mIndex.data(), sizeof(mIndex[0]),
+									  mIndex.size(),
+									  mFile) == mIndex.size()) &&
+			fwrite(&interfaces, sizeof(interfaces), 1, mFile) == 1;
+
+		for (auto name = mInterfaces.begin();
+			 written && name != mInterfaces.end(); ++name) {
+			u8 length = name->size();
+
+			written = fwrite(&length, sizeof(length), 1, mFile) == 1 &&
+					  (length == 0 ||
+					   fwrite(name->data(), length, 1, mFile) == 1);
+		}
+
+		// Without the footer, the blocks are found when reading the file
+		if (written) {
+			fwrite(&footer, sizeof(footer), 1, mFile);
+		}
+	}
+
+	if (mFile) {
+		fclose(mFile);
+	}
+
+	mFile = nullptr;
+	mOffset = 0;
+	memset(&mBlock, 0, sizeof(mBlock));
+	mRecords.clear();
+	mLastTime = 0;
+	mIndex.clear();
+	mInterfaces.clear();
+	mFrames = 0;
+}
+
+} /* namespace Can */
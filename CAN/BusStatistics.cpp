@@ -0,0 +1,219 @@
+/*
+ * BusStatistics.cpp
+ */
+
+#include <BusStatistics.h>
+
+// Polynomial of the CRC of the classic frames
+#define CAN_CRC15_POLY 0x4599
+
+// Bits after the CRC field: CRC delimiter, ACK slot and delimiter, end of
+// frame and interframe space
+#define CAN_TRAILER_BITS 13
+
+// Bits with the same value after which a stuff bit is inserted
+#define CAN_STUFF_RUN 5
+
+using namespace Utils;
+
+namespace Can
+{
+namespace
+{
+/*
+ * Counts the bits of a frame as they are put on the bus, inserting the stuff
+ * bits, and computes the CRC of the classic frames along the way
+ */
+class BitCounter
+{
+  private:
+	u32 mBits;
+	u32 mRun;
+	u32 mLast;
+	u16 mCrc;
+
+  public:
+	BitCounter() : mBits(0), mRun(0), mLast(2), mCrc(0) {}
+
+	void putBit(u32 bit)
+	{
+		++mBits;
+
+		bool crcNext = bit ^ ((mCrc >> 14) & 1);
+		mCrc = (mCrc << 1) & 0x7FFF;
+		if (crcNext)
+			mCrc ^= CAN_CRC15_POLY;
+
+		if (bit != mLast) {
+			mLast = bit;
+			mRun = 1;
+		} else if (++mRun == CAN_STUFF_RUN) {
+			// The stuff bit starts a new run with the opposite value
+			++mBits;
+			mLast = !bit;
+			mRun = 1;
+		}
+	}
+
+	// Most significant bit first
+	void put(u32 value, u32 count)
+	{
+		while (count-- > 0) {
+			putBit((value >> count) & 1);
+		}
+	}
+
+	u32 getBits() const { return mBits; }
+	u16 getCrc() const { return mCrc; }
+};
+} // namespace
+
+BusStatistics::BusStatistics(u32 bitrate) : mBitrate(bitrate)
+{
+	reset();
+}
+
+void BusStatistics::reset()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	for (size_t i = 0; i < BUS_STATS_WINDOWS; ++i) {
+		mWindows[i].index = -1;
+		mWindows[i].frames = 0;
+		mWindows[i].bits = 0;
+	}
+
+	mPeakBits = 0;
+	mFrames = 0;
+	mBits = 0;
+}
+
+void BusStatistics::addFrames(const CanFrame *frames, size_t count,
+							  const TimeStamp &now)
+{
+	if (count == 0)
+		return;
+
+	u64 bits = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		bits += getFrameBits(frames[i]);
+	}
+
+	s64 index = now.getNanoSec() / ((s64)BUS_STATS_WINDOW * 1000000);
+
+	std::lock_guard<std::mutex> lock(mLock);
+
+	Window &window = mWindows[index % BUS_STATS_WINDOWS];
+
+	if (window.index != index) {
+		window.index = index;
+		window.frames = 0;
+		window.bits = 0;
+	}
+
+	window.frames += count;
+	window.bits += bits;
+
+	if (window.bits > mPeakBits)
+		mPeakBits = window.bits;
+
+	mFrames += count;
+	mBits += bits;
+}
+
+BusStatistics::Snapshot BusStatistics::getSnapshot(const TimeStamp &now) const
+{
+	Snapshot snapshot;
+
+	// The last complete windows, the current one is still being filled
+	s64 current = now.getNanoSec() / ((s64)BUS_STATS_WINDOW * 1000000);
+	u64 frames = 0, bits = 0;
+
+	std::lock_guard<std::mutex> lock(mLock);
+
+	for (size_t i = 0; i < BUS_STATS_WINDOWS; ++i) {
+		const Window &window = mWindows[i];
+
+		if (window.index >= current - BUS_STATS_WINDOWS &&
+			window.index < current) {
+			frames += window.frames;
+			bits += window.bits;
+		}
+	}
+
+	double seconds = BUS_STATS_WINDOWS * BUS_STATS_WINDOW / 1000.0;
+
+	snapshot.framesPerSecond = frames / seconds;
+	snapshot.bitsPerSecond = bits / seconds;
+	snapshot.load = 100.0 * snapshot.bitsPerSecond / mBitrate;
+	snapshot.peakLoad =
+		100.0 * mPeakBits / (mBitrate * (BUS_STATS_WINDOW / 1000.0));
+	snapshot.frames = mFrames;
+	snapshot.bits = mBits;
+
+	return snapshot;
+}
+
+u32 BusStatistics::getFrameBits(const CanFrame &frame)
+{
+	BitCounter counter;
+	u32 id = frame.getId();
+
+	counter.putBit(0); // Start of frame
+
+	if (frame.isExtendedFormat()) {
+		counter.put(id >> 18, 11); // Base identifier
+		counter.put(0x3, 2);	   // SRR and IDE
+		counter.put(id, 18);	   // Identifier extension
+	} else {
+		counter.put(id, 11);
+		counter.putBit(0); // RTR (RRS in CAN FD)
+		counter.putBit(0); // IDE
+	}
+
+	u8 dlc = CanFrame::lengthToDlc(frame.getDataLength());
+
+	if (!frame.isFdFormat()) {
+		if (frame.isExtendedFormat())
+			counter.put(0, 3); // RTR, r1 and r0
+		else
+			counter.putBit(0); // r0
+
+		counter.put(dlc, 4);
+
+		for (size_t i = 0; i < frame.getDataLength(); ++i) {
+			counter.put(frame.getRawData()[i], 8);
+		}
+
+		counter.put(counter.getCrc(), 15);
+
+		return counter.getBits() + CAN_TRAILER_BITS;
+	}
+
+	if (frame.isExtendedFormat())
+		counter.putBit(0); // RRS
+
+	counter.putBit(1); // FDF
+	counter.putBit(0); // res
+	counter.putBit(frame.isBitrateSwitch());
+	counter.putBit(frame.isErrorStateIndicator());
+	counter.put(dlc, 4);
+
+	// Padded up to the length given by the DLC
+	size_t length = CanFrame::dlcToLength(dlc);
+
+	for (size_t i = 0; i < length; ++i) {
+		counter.put(i < frame.getDataLength() ? frame.getRawData()[i] : 0, 8);
+	}
+
+	// Stuff count and CRC, with a fixed stuff bit before them and after
+	// every 4 bits instead of the dynamic stuffing
+	u32 crcBits = (length > 16 ? 21 : 17);
+	u32 fixedBits = 4 + crcBits;
+
+	return counter.getBits() + fixedBits + 1 + fixedBits / 4 +
+		   CAN_TRAILER_BITS;
+}
+
+} /* namespace Can */
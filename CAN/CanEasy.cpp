@@ -6,12 +6,14 @@
  */
 
 #include <CanEasy.h>
+#include <CommonCanSender.h>
 
 namespace Can
 {
 std::map<std::string, std::shared_ptr<ICanSender>> CanEasy::mSenders;
 CanSniffer CanEasy::mSniffer;
 std::set<std::string> CanEasy::mInitializedIfaces;
+std::map<std::string, std::shared_ptr<BusStatistics>> CanEasy::mStatistics;
 
 void CanEasy::initialize(u32 bitrate, OnReceiveFramePtr recvCB,
 			 OnTimeoutPtr timeoutCB)
@@ -23,13 +25,26 @@ void CanEasy::initialize(u32 bitrate, OnReceiveFramePtr recvCB,
 	mSniffer.setOnTimeout(timeoutCB);
 
 	for (auto iter = canHelpers.begin(); iter != canHelpers.end(); ++iter) {
-		ICanSender *sender = iter->second->allocateCanSender();
-		mSenders[iter->first] = std::shared_ptr<ICanSender>(sender);
+		std::shared_ptr<BusStatistics> statistics =
+			std::make_shared<BusStatistics>(bitrate);
 
 		CommonCanReceiver *receiver = iter->second->allocateCanReceiver();
 		receiver->setInterface(iter->first);
+		receiver->setCpu(iter->second->getRxCpu());
+		receiver->setBusStatistics(statistics);
 		mSniffer.addReceiver(receiver);
 
+		ICanSender *sender = iter->second->allocateCanSender();
+		mSenders[iter->first] = std::shared_ptr<ICanSender>(sender);
+
+		// Not to count twice the frames that the receiver also gets
+		CommonCanSender *commonSender = dynamic_cast<CommonCanSender *>(sender);
+
+		if (commonSender && !receiver->receivesOwnFrames())
+			commonSender->setBusStatistics(statistics);
+
+		mStatistics[iter->first] = statistics;
+
 		mInitializedIfaces.insert(iter->first);
 	}
 }
@@ -40,9 +55,18 @@ void CanEasy::initialize(u32 bitrate)
 		ICanHelper::createCanHelpers(bitrate);
 
 	for (auto iter = canHelpers.begin(); iter != canHelpers.end(); ++iter) {
+		std::shared_ptr<BusStatistics> statistics =
+			std::make_shared<BusStatistics>(bitrate);
+
 		ICanSender *sender = iter->second->allocateCanSender();
 
+		CommonCanSender *commonSender = dynamic_cast<CommonCanSender *>(sender);
+
+		if (commonSender)
+			commonSender->setBusStatistics(statistics);
+
 		mSenders[iter->first] = std::shared_ptr<ICanSender>(sender);
+		mStatistics[iter->first] = statistics;
 		mInitializedIfaces.insert(iter->first);
 	}
 }
@@ -63,10 +87,23 @@ std::shared_ptr<ICanSender> CanEasy::getSender(const std::string &interface)
 	return nullptr;
 }
 
+std::shared_ptr<BusStatistics>
+CanEasy::getBusStatistics(const std::string &interface)
+{
+	auto iter = mStatistics.find(interface);
+
+	if (iter != mStatistics.end()) {
+		return iter->second;
+	}
+
+	return nullptr;
+}
+
 void CanEasy::finalize()
 {
 	// Auto pointers will free the senders
 	mSenders.clear();
+	mStatistics.clear();
 
 	// Free the helpers
 	ICanHelper::deallocateCanHelpers();
@@ -7,22 +7,46 @@
 
 #include <iomanip>
 #include <sstream>
+#include <type_traits>
 
 #include "CanFrame.h"
 
 namespace Can
 {
-CanFrame::CanFrame() : mId(0) {}
+static_assert(std::is_trivially_copyable<CanFrame>::value,
+			  "CanFrame must be copied without allocations");
 
-CanFrame::~CanFrame() {}
+CanFrame::CanFrame()
+	: mExtendedFormat(false), mFdFormat(false), mBitrateSwitch(false),
+	  mErrorStateIndicator(false), mId(0), mLength(0)
+{
+}
+
+static const u8 fdDlcToLength[] = {0,  1,  2,  3,  4,  5,  6,  7,
+								   8, 12, 16, 20, 24, 32, 48, 64};
+
+u8 CanFrame::lengthToDlc(size_t length)
+{
+	for (u8 dlc = 0; dlc < sizeof(fdDlcToLength); ++dlc) {
+		if (fdDlcToLength[dlc] >= length)
+			return dlc;
+	}
+
+	return sizeof(fdDlcToLength) - 1;
+}
+
+size_t CanFrame::dlcToLength(u8 dlc)
+{
+	return fdDlcToLength[dlc & 0x0F];
+}
 
 std::string CanFrame::hexDump() const
 {
 	std::stringstream sstr;
 
-	for (auto c = mData.begin(); c != mData.end(); ++c) {
+	for (u8 i = 0; i < mLength; ++i) {
 		sstr << std::setfill('0') << std::setw(2) << std::hex
-			 << (static_cast<u32>(*c) & 0xFF) << " ";
+			 << static_cast<u32>(mData[i]) << " ";
 	}
 
 	return sstr.str();
@@ -5,6 +5,16 @@
  *      Author: fernado
  */
 
+#include <utility>
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
 #include <Assert.h>
 #include <CanSniffer.h>
 
@@ -12,6 +22,35 @@ using namespace Utils;
 
 namespace Can
 {
+namespace
+{
+// Pins the calling thread to the CPUs of the given receivers, if any
+void pinToReceivers(CommonCanReceiver *const *receivers, size_t count)
+{
+	cpu_set_t cpus;
+	bool pinned = false;
+
+	CPU_ZERO(&cpus);
+
+	for (size_t i = 0; i < count; ++i) {
+		int cpu = receivers[i]->getCpu();
+
+		if (cpu >= 0 && cpu < CPU_SETSIZE) {
+			CPU_SET(cpu, &cpus);
+			pinned = true;
+		}
+	}
+
+	if (pinned)
+		pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+}
+
+void onStatisticsReady(int, void *data)
+{
+	static_cast<CommonCanReceiver *>(data)->drainStatistics();
+}
+} // namespace
+
 CanSniffer::CanSniffer(OnReceiveFramePtr recvCB, OnTimeoutPtr timeoutCB,
 					   void *data)
 	: mRcvCB(recvCB), mTimeoutCB(timeoutCB), mData(data)
@@ -26,14 +65,40 @@ CanSniffer::~CanSniffer()
 	}
 }
 
+void CanSniffer::addReceiver(CommonCanReceiver *receiver)
+{
+	mReceivers.push_back(receiver);
+
+	watchStatistics(receiver);
+}
+
 void CanSniffer::setFilters(std::set<CanFilter> filters)
 {
 	for (auto receiver = mReceivers.begin(); receiver != mReceivers.end();
 		 ++receiver) {
 		(*receiver)->setFilters(filters);
+
+		watchStatistics(*receiver);
 	}
 }
 
+void CanSniffer::watchStatistics(CommonCanReceiver *receiver)
+{
+	// The frames not matching the filters in kernel space are accounted
+	// from another descriptor, watched as the user ones
+	int fd = receiver->getStatisticsFD();
+
+	if (fd < 0)
+		return;
+
+	for (auto userFd = mUserFds.begin(); userFd != mUserFds.end(); ++userFd) {
+		if (userFd->fd == fd)
+			return;
+	}
+
+	addUserFd(fd, onStatisticsReady, receiver);
+}
+
 int CanSniffer::wait_fd(timeval tv, fd_set &rdfs) const
 {
 	int maxFd = -1;
@@ -51,6 +116,14 @@ int CanSniffer::wait_fd(timeval tv, fd_set &rdfs) const
 				maxFd = (*receiver)->getFD();
 		}
 
+		for (auto userFd = mUserFds.begin(); userFd != mUserFds.end();
+			 ++userFd) {
+			FD_SET(userFd->fd, &rdfs);
+
+			if (userFd->fd > maxFd)
+				maxFd = userFd->fd;
+		}
+
 		if (maxFd == -1)
 			return -EINVAL;
 
@@ -61,29 +134,92 @@ int CanSniffer::wait_fd(timeval tv, fd_set &rdfs) const
 	return result;
 }
 
-void CanSniffer::notify_recv(CommonCanReceiver *recv) const
+size_t CanSniffer::filterFrames(CommonCanReceiver *recv, CanFrame *frames,
+								TimeStamp *tStamps, size_t count)
 {
-	CanFrame canFrame;
-	TimeStamp timestamp;
+	if (recv->getBusStatistics() && recv->getStatisticsFD() < 0)
+		recv->getBusStatistics()->addFrames(frames, count);
+
+	if (recv->isKernelFiltering())
+		return count;
+
+	// Compact the frames that pass the filter at the beginning of the buffers
+	size_t accepted = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		if (!recv->filter(frames[i].getId()))
+			continue;
 
-	bool ret = recv->receive(canFrame, timestamp);
-	if (ret == false)
+		if (accepted != i) {
+			std::swap(frames[accepted], frames[i]);
+			tStamps[accepted] = tStamps[i];
+		}
+
+		++accepted;
+	}
+
+	return accepted;
+}
+
+void CanSniffer::dispatch(const std::string &interface, size_t count) const
+{
+	if (count == 0)
 		return;
 
-	ret = recv->filter(canFrame.getId());
-	if (ret == false)
+	if (mRcvBatchCB) {
+		(mRcvBatchCB)(mFrames.data(), mTimeStamps.data(), count, interface,
+					  mData);
+		return;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		(mRcvCB)(mFrames[i], mTimeStamps[i], interface, mData);
+	}
+}
+
+void CanSniffer::checkDrops(size_t index) const
+{
+	if (!mDropCB)
 		return;
 
-	(mRcvCB)(canFrame, timestamp, recv->getInterface(), mData);
+	if (mReportedDrops.size() < mReceivers.size())
+		mReportedDrops.resize(mReceivers.size(), 0);
+
+	CommonCanReceiver *recv = mReceivers[index];
+	u64 total = recv->getDroppedFrames();
+
+	if (total != mReportedDrops[index]) {
+		(mDropCB)(total - mReportedDrops[index], total, recv->getInterface(),
+				  mData);
+		mReportedDrops[index] = total;
+	}
+}
+
+size_t CanSniffer::notify_recv(size_t index) const
+{
+	CommonCanReceiver *recv = mReceivers[index];
+
+	size_t count = recv->receiveBatch(mFrames.data(), mTimeStamps.data(),
+									  mFrames.size());
+
+	checkDrops(index);
+
+	dispatch(recv->getInterface(),
+			 filterFrames(recv, mFrames.data(), mTimeStamps.data(), count));
+
+	return count;
 }
 
 void CanSniffer::notify(fd_set& rdfs) const
 {
-	for (auto receiver = mReceivers.begin();
-			receiver != mReceivers.end(); ++receiver) {
+	for (size_t i = 0; i < mReceivers.size(); ++i) {
+		if (FD_ISSET(mReceivers[i]->getFD(), &rdfs))
+			notify_recv(i);
+	}
 
-		if (FD_ISSET((*receiver)->getFD(), &rdfs))
-			notify_recv(*receiver);
+	for (auto userFd = mUserFds.begin(); userFd != mUserFds.end(); ++userFd) {
+		if (FD_ISSET(userFd->fd, &rdfs))
+			(userFd->callback)(userFd->fd, userFd->data);
 	}
 }
 
@@ -94,9 +230,11 @@ void CanSniffer::sniff(u32 timeout) const
 	int result;
 
 	ASSERT(!mReceivers.empty());
-	ASSERT(mRcvCB != nullptr);
+	ASSERT(mRcvCB != nullptr || mRcvBatchCB != nullptr);
 	ASSERT(mTimeoutCB != nullptr);
 
+	pinToReceivers(mReceivers.data(), mReceivers.size());
+
 	do {
 		tv.tv_sec = timeout / 1000;
 		tv.tv_usec = (timeout % 1000) / 1000000;
@@ -112,4 +250,226 @@ void CanSniffer::sniff(u32 timeout) const
 	} while (mRunning);
 }
 
+void CanSniffer::sniffEpoll(u32 timeout) const
+{
+	epoll_event events[CAN_SNIFFER_BATCH_SIZE];
+	epoll_event event;
+	int result;
+
+	ASSERT(!mReceivers.empty());
+	ASSERT(mRcvCB != nullptr || mRcvBatchCB != nullptr);
+	ASSERT(mTimeoutCB != nullptr);
+
+	int epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+	if (epollFd < 0)
+		return;
+
+	pinToReceivers(mReceivers.data(), mReceivers.size());
+
+	// The event data holds the index of the receiver, user fds come after them
+	for (size_t i = 0; i < mReceivers.size(); ++i) {
+		event.events = EPOLLIN | EPOLLET;
+		event.data.u64 = i;
+
+		epoll_ctl(epollFd, EPOLL_CTL_ADD, mReceivers[i]->getFD(), &event);
+	}
+
+	for (size_t i = 0; i < mUserFds.size(); ++i) {
+		event.events = EPOLLIN;
+		event.data.u64 = mReceivers.size() + i;
+
+		epoll_ctl(epollFd, EPOLL_CTL_ADD, mUserFds[i].fd, &event);
+	}
+
+	do {
+		result = epoll_wait(epollFd, events, CAN_SNIFFER_BATCH_SIZE, timeout);
+
+		if (result < 0)
+			continue; // Interrupted
+
+		if (result == 0) {
+			(mTimeoutCB)();
+			continue;
+		}
+
+		for (int i = 0; i < result; ++i) {
+			size_t index = events[i].data.u64;
+
+			if (index < mReceivers.size()) {
+				// Edge triggered, drain the receiver
+				while (notify_recv(index) > 0)
+					;
+			} else {
+				const UserFd &userFd = mUserFds[index - mReceivers.size()];
+				(userFd.callback)(userFd.fd, userFd.data);
+			}
+		}
+	} while (mRunning);
+
+	close(epollFd);
+}
+
+void CanSniffer::pipelineReceive(size_t index, u32 timeout)
+{
+	CommonCanReceiver *recv = mReceivers[index];
+	Pipeline &pipeline = *mPipelines[index];
+
+	std::vector<CanFrame> frames(CAN_SNIFFER_BATCH_SIZE);
+	std::vector<TimeStamp> tStamps(CAN_SNIFFER_BATCH_SIZE);
+
+	pollfd fd;
+	fd.fd = recv->getFD();
+	fd.events = POLLIN;
+
+	RxSlot slot;
+	const u64 wakeUp = 1;
+
+	pinToReceivers(&recv, 1);
+
+	while (mRunning) {
+		if (poll(&fd, 1, timeout) <= 0)
+			continue; // Timeout or interrupted, check if we must finish
+
+		size_t count;
+
+		// Drain the receiver
+		while (mRunning && (count = recv->receiveBatch(
+								frames.data(), tStamps.data(), frames.size())) > 0) {
+
+			count = filterFrames(recv, frames.data(), tStamps.data(), count);
+
+			for (size_t i = 0; i < count; ++i) {
+				slot.frame = frames[i];
+				slot.tStamp = tStamps[i];
+
+				while (!pipeline.ring.push(slot)) {
+					if (mDropPolicy == DROP_NEWEST || !mRunning) {
+						++pipeline.overflows;
+						break;
+					}
+
+					std::this_thread::yield(); // Wait for the consumer
+				}
+			}
+
+			if (count > 0) {
+				// Only fails if the counter overflows, in which case the
+				// consumer has a notification pending anyway
+				ssize_t written = write(mPipelineEventFd, &wakeUp, sizeof(wakeUp));
+				(void)written;
+			}
+		}
+	}
+}
+
+void CanSniffer::sniffPipelined(u32 timeout)
+{
+	ASSERT(!mReceivers.empty());
+	ASSERT(mRcvCB != nullptr || mRcvBatchCB != nullptr);
+	ASSERT(mTimeoutCB != nullptr);
+
+	mPipelineEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (mPipelineEventFd < 0)
+		return;
+
+	{
+		// Not to be freed under getPipelineStats()
+		std::lock_guard<std::mutex> lock(mPipelinesLock);
+
+		mPipelines.clear();
+
+		for (size_t i = 0; i < mReceivers.size(); ++i) {
+			mPipelines.emplace_back(new Pipeline(mPipelineCapacity));
+		}
+	}
+
+	for (size_t i = 0; i < mPipelines.size(); ++i) {
+		mPipelines[i]->thread =
+			std::thread(&CanSniffer::pipelineReceive, this, i, timeout);
+	}
+
+	// The consumer waits for the receive threads and for the user fds
+	std::vector<pollfd> fds(1 + mUserFds.size());
+
+	fds[0].fd = mPipelineEventFd;
+	fds[0].events = POLLIN;
+
+	for (size_t i = 0; i < mUserFds.size(); ++i) {
+		fds[i + 1].fd = mUserFds[i].fd;
+		fds[i + 1].events = POLLIN;
+	}
+
+	RxSlot slot;
+	u64 value;
+	int result;
+
+	do {
+		result = poll(fds.data(), fds.size(), timeout);
+
+		if (result < 0)
+			continue; // Interrupted
+
+		if (result == 0) {
+			(mTimeoutCB)();
+			continue;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			// Reset the counter before draining, so that the frames pushed
+			// from now on wake us up again
+			if (read(mPipelineEventFd, &value, sizeof(value)) < 0)
+				value = 0;
+
+			for (size_t i = 0; i < mPipelines.size(); ++i) {
+				size_t count;
+
+				do {
+					for (count = 0; count < mFrames.size() &&
+									mPipelines[i]->ring.pop(slot);
+						 ++count) {
+						mFrames[count] = slot.frame;
+						mTimeStamps[count] = slot.tStamp;
+					}
+
+					dispatch(mReceivers[i]->getInterface(), count);
+				} while (count == mFrames.size());
+
+				checkDrops(i);
+			}
+		}
+
+		for (size_t i = 0; i < mUserFds.size(); ++i) {
+			if (fds[i + 1].revents & POLLIN)
+				(mUserFds[i].callback)(mUserFds[i].fd, mUserFds[i].data);
+		}
+	} while (mRunning);
+
+	for (size_t i = 0; i < mPipelines.size(); ++i) {
+		mPipelines[i]->thread.join();
+	}
+
+	close(mPipelineEventFd);
+	mPipelineEventFd = -1;
+}
+
+CanSniffer::PipelineStats CanSniffer::getPipelineStats(size_t receiver) const
+{
+	PipelineStats stats = {};
+
+	std::lock_guard<std::mutex> lock(mPipelinesLock);
+
+	if (receiver < mPipelines.size()) {
+		const Pipeline &pipeline = *mPipelines[receiver];
+
+		stats.capacity = pipeline.ring.capacity();
+		stats.occupancy = pipeline.ring.size();
+		stats.highWaterMark = pipeline.ring.getHighWaterMark();
+		stats.overflows = pipeline.overflows.load();
+	}
+
+	return stats;
+}
+
 } /* namespace Can */
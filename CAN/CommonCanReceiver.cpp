@@ -11,26 +11,49 @@ bool CommonCanReceiver::setInterface(const std::string &interface)
 
 bool CommonCanReceiver::setFilters(std::set<CanFilter> filters)
 {
-	mFilters = filters;
+	mFilterGroups.clear();
+
+	for (auto filter = filters.begin(); filter != filters.end(); ++filter) {
+		auto group = mFilterGroups.begin();
+
+		while (group != mFilterGroups.end() &&
+			   group->mask != filter->getMask()) {
+			++group;
+		}
+
+		if (group == mFilterGroups.end()) {
+			mFilterGroups.push_back(MaskGroup());
+			group = mFilterGroups.end() - 1;
+			group->mask = filter->getMask();
+		}
+
+		group->ids.insert(filter->getId() & filter->getMask());
+	}
 
 	return true;
 }
 
-bool CommonCanReceiver::filter(u32 id)
+size_t CommonCanReceiver::receiveBatch(CanFrame *frames,
+									   Utils::TimeStamp *tStamps, size_t max)
 {
-	bool filtered = false;
+	if (max == 0)
+		return 0;
+
+	return receive(frames[0], tStamps[0]) ? 1 : 0;
+}
 
-	if (mFilters.empty())
+bool CommonCanReceiver::filter(u32 id)
+{
+	if (mFilterGroups.empty())
 		return true; // If no filters set, send everything
 
-	for (auto filter = mFilters.begin(); filter != mFilters.end(); ++filter) {
-		if ((filter->getId() & filter->getMask()) == (id & filter->getMask())) {
-			filtered = true;
-			break;
-		}
+	for (auto group = mFilterGroups.begin(); group != mFilterGroups.end();
+		 ++group) {
+		if (group->ids.count(id & group->mask))
+			return true;
 	}
 
-	return filtered;
+	return false;
 }
 
 } // namespace Can
@@ -5,40 +5,113 @@
  *      Author: famez
  */
 
-#include <unistd.h>
+#include <errno.h>
 
-#include <Utils.h>
+#include <algorithm>
 
 #include "CommonCanSender.h"
 
 namespace Can
 {
-void CommonCanSender::CanFrameRing::setFrames(
-	const std::vector<CanFrame> &frames)
+/*
+ * Compares the indexes of the rings by deadline, to keep the earliest one at
+ * the top of the heap
+ */
+class CommonCanSender::RingDeadlineGreater
 {
-	mFrames = frames;
-	mCurrentpos = 0;
+  private:
+	const std::vector<CanFrameRing> &mRings;
+
+  public:
+	RingDeadlineGreater(const std::vector<CanFrameRing> &rings)
+		: mRings(rings)
+	{
+	}
+
+	bool operator()(size_t a, size_t b) const
+	{
+		return mRings[a].getDeadline() > mRings[b].getDeadline();
+	}
+};
+
+size_t CommonCanSender::IdSequenceHash::operator()(
+	const std::vector<u32> &ids) const
+{
+	size_t hash = ids.size();
+
+	for (auto id = ids.begin(); id != ids.end(); ++id) {
+		hash ^= std::hash<u32>()(*id) + 0x9E3779B9 + (hash << 6) + (hash >> 2);
+	}
+
+	return hash;
 }
 
-void CommonCanSender::CanFrameRing::pushFrame(const CanFrame &frame)
+void CommonCanSender::CanFrameRing::setFrames(
+	const std::vector<CanFrame> &frames)
 {
-	mFrames.push_back(frame);
+	mPayloads = std::make_shared<FramePayloads>(frames);
 	mCurrentpos = 0;
 }
 
 /* advance to the next frame */
 void CommonCanSender::CanFrameRing::shift()
 {
-	if (mCurrentpos == mFrames.size())
-		return;
-
-	if (++mCurrentpos == mFrames.size())
+	if (++mCurrentpos == getFrames().size())
 		mCurrentpos = 0;
 }
 
+/*
+ * The published payloads are taken at the beginning of every round, so that
+ * all the frames of a round (e.g. a BAM transfer) come from the same update
+ */
+CanFrame &CommonCanSender::CanFrameRing::getCurrentFrame()
+{
+	if (mCurrentpos == 0)
+		mPayloads->fetch();
+
+	return mPayloads->getFrames()[mCurrentpos];
+}
+
+void CommonCanSender::CanFrameRing::measureRound(const Utils::TimeStamp &now)
+{
+	if (mRoundStart.getNanoSec() != 0) {
+		u64 period = (now - mRoundStart).getNanoSec() / 1000;
+
+		if (mSamples == 0 || period < mMinPeriod)
+			mMinPeriod = period;
+		if (period > mMaxPeriod)
+			mMaxPeriod = period;
+
+		u64 nominal = (u64)mPeriod * 1000;
+
+		mSumPeriods += period;
+		mSumDeviations += (period > nominal ? period - nominal : nominal - period);
+		++mSamples;
+	}
+
+	mRoundStart = now;
+}
+
+CommonCanSender::PeriodStats
+CommonCanSender::CanFrameRing::getPeriodStats() const
+{
+	PeriodStats stats;
+
+	stats.nominal = mPeriod;
+	stats.samples = mSamples;
+	stats.min = mMinPeriod;
+	stats.max = mMaxPeriod;
+	stats.mean = (mSamples > 0 ? mSumPeriods / mSamples : 0);
+	stats.jitter = (mSamples > 0 ? mSumDeviations / mSamples : 0);
+
+	return stats;
+}
+
 u32 CommonCanSender::CanFrameRing::getCurrentPeriod() const
 {
-	if (mFrames.empty())
+	const std::vector<CanFrame> &frames = getFrames();
+
+	if (frames.empty())
 		return 0;
 
 	u32 period;
@@ -46,18 +119,19 @@ u32 CommonCanSender::CanFrameRing::getCurrentPeriod() const
 	// Little algorithm to compensate the loss of accuracy when dividing the
 	// period by the number of frames
 	if (mCurrentpos + 1 ==
-			mFrames.size()) { // Last frame. The period is slightly different to
+			frames.size()) { // Last frame. The period is slightly different to
 		// compensate the loss of the decimal part for the
 		// other frames which is accumulated
-		period = mPeriod - (mPeriod / mFrames.size()) * (mFrames.size() - 1);
+		period = mPeriod - (mPeriod / frames.size()) * (frames.size() - 1);
 	} else { // Any other frame.
-		period = mPeriod / mFrames.size();
+		period = mPeriod / frames.size();
 	}
 
 	return period;
 }
 
-CommonCanSender::CommonCanSender() : mFinished(false)
+CommonCanSender::CommonCanSender()
+	: mPassWindow(0), mPhaseOffsets(false), mFinished(false)
 {
 	initialize();
 }
@@ -67,6 +141,29 @@ CommonCanSender::~CommonCanSender()
 	finalize();
 }
 
+size_t CommonCanSender::_sendFrames(const CanFrame *frames, size_t count) const
+{
+	for (size_t i = 0; i < count; ++i) {
+		_sendFrame(frames[i]);
+	}
+
+	return count;
+}
+
+void CommonCanSender::sendFrameOnce(const CanFrame &frame)
+{
+	_sendFrame(frame);
+
+	if (mBusStatistics)
+		mBusStatistics->addFrames(&frame, 1);
+}
+
+void CommonCanSender::notifySendError(const CanFrame &frame, int error) const
+{
+	if (mErrorCallback)
+		mErrorCallback(frame, error);
+}
+
 bool CommonCanSender::initialize()
 {
 	// Initialize the thread in charge of sending the frames
@@ -78,71 +175,206 @@ bool CommonCanSender::initialize()
 
 bool CommonCanSender::finalize()
 {
-	if (mFinished)
-		return false; 	// Already finalized
-	mFinished = true; 	// This makes the thread finish
+	{
+		std::lock_guard<std::mutex> lock(mFramesLock);
+
+		if (mFinished)
+			return false; // Already finalized
+		mFinished = true; // This makes the thread finish
+	}
+
+	mWakeUp.notify_all();
 	mThread->join(); 	// Wait for thread to finish doing
 						// proper cleaning and claim resources
 	return true;
 }
 
-bool CommonCanSender::sendFrame(CanFrame frame, u32 period,
+SendHandle CommonCanSender::sendFrame(CanFrame frame, u32 period,
 		OnSendCallback callback)
 {
 	std::vector<CanFrame> frames;
 	frames.push_back(frame);
 
-	sendFrames(frames, period, callback);
+	return sendFrames(frames, period, callback);
+}
 
-	return true;
+SendHandle CommonCanSender::sendFrame(CanFrame frame, u32 period,
+		OnSendRawCallback callback)
+{
+	std::vector<CanFrame> frames;
+	frames.push_back(frame);
+
+	return sendFrames(frames, period, callback);
 }
 
-bool CommonCanSender::sendFrames(std::vector<CanFrame> frames, u32 period,
-		OnSendCallback callback)
+SendHandle CommonCanSender::sendFrames(std::vector<CanFrame> frames,
+		u32 period, OnSendCallback callback)
 {
 	if (frames.empty())
-		return false;
+		return SendHandle();
 
 	CanFrameRing ring(period, callback);
 
 	ring.setFrames(frames);
 
-	// Check if a frame with the same id is being sent
-	auto found = mFrameRings.end();
+	return addRing(std::move(ring));
+}
 
-	// The access is concurrent but only for reading, not necessary to lock the
-	// mutex.
-	for (auto iter = mFrameRings.begin(); iter != mFrameRings.end(); ++iter) {
-		if (iter->getFrames().size() != ring.getFrames().size())
-			continue;
+SendHandle CommonCanSender::sendFrames(std::vector<CanFrame> frames,
+		u32 period, OnSendRawCallback callback)
+{
+	if (frames.empty())
+		return SendHandle();
 
-		found = iter;
+	CanFrameRing ring(period, callback);
 
-		for (auto iter2 = iter->getFrames().begin();
-				iter2 != iter->getFrames().end(); ++iter2) {
-			if (iter2->getId() !=
-					(ring.getFrames())[iter2 - iter->getFrames().begin()].getId()) {
-				found = mFrameRings.end();
-				break;
-			}
+	ring.setFrames(frames);
+
+	return addRing(std::move(ring));
+}
+
+SendHandle CommonCanSender::addRing(CanFrameRing &&ring)
+{
+	SendHandle handle(ring.getPayloads());
+
+	std::vector<u32> ids = getIds(ring.getFrames());
+
+	std::unique_lock<std::mutex> lock(mFramesLock);
+
+	// Check if a frame with the same id is being sent
+	auto found = mRingIndex.find(ids);
+
+	if (found != mRingIndex.end()) {
+		// Replaced in place, the new ring is due now
+		mFrameRings[found->second] = std::move(ring);
+		rebuildSchedule();
+	} else {
+		if (mPhaseOffsets) {
+			u32 index = mPeriodRings[ring.getPeriod()]++;
+
+			ring.setDeadline(ring.getDeadline() +
+							 getPhaseOffset(index, ring.getCurrentPeriod()));
 		}
 
-		if (found != mFrameRings.end())
-			break;
+		mRingIndex[ids] = mFrameRings.size();
+		mFrameRings.push_back(std::move(ring));
+
+		mSchedule.push_back(mFrameRings.size() - 1);
+		std::push_heap(mSchedule.begin(), mSchedule.end(),
+					   RingDeadlineGreater(mFrameRings));
 	}
 
-	// To modify, lock the mutex
-	mFramesLock.lock();
+	lock.unlock();
+
+	// The new ring is due now, wake the sender thread up
+	mWakeUp.notify_one();
+
+	return handle;
+}
+
+bool CommonCanSender::updateFrames(const std::vector<CanFrame> &frames)
+{
+	std::vector<u32> ids = getIds(frames);
 
-	if (found != mFrameRings.end()) {
-		mFrameRings.erase(found);
+	std::lock_guard<std::mutex> lock(mFramesLock);
+
+	auto found = mRingIndex.find(ids);
+
+	if (found == mRingIndex.end())
+		return false;
+
+	// Same as through a SendHandle, without blocking the sender thread
+	return mFrameRings[found->second].getPayloads()->publish(frames);
+}
+
+std::vector<u32> CommonCanSender::getIds(const std::vector<CanFrame> &frames)
+{
+	std::vector<u32> ids;
+
+	ids.reserve(frames.size());
+
+	for (auto frame = frames.begin(); frame != frames.end(); ++frame) {
+		ids.push_back(frame->getId());
+	}
+
+	return ids;
+}
+
+/*
+ * Offset of the index-th ring within the period. The offsets follow the van
+ * der Corput sequence (0, 1/2, 1/4, 3/4, 1/8...), which keeps them evenly
+ * spread whatever the number of rings.
+ */
+Utils::TimeStamp CommonCanSender::getPhaseOffset(u32 index, u32 period)
+{
+	u32 reversed = 0;
+
+	for (int i = 0; i < 32; ++i) {
+		reversed = (reversed << 1) | ((index >> i) & 1);
 	}
-	mFrameRings.push_back(ring);
 
-	mFramesLock.unlock();
+	double fraction = reversed / 4294967296.0;
+
+	return Utils::TimeStamp::fromNanoSec(
+		static_cast<s64>(fraction * period * 1000000));
+}
+
+void CommonCanSender::setPhaseOffsets(bool enable)
+{
+	std::lock_guard<std::mutex> lock(mFramesLock);
+
+	mPhaseOffsets = enable;
+}
+
+void CommonCanSender::setPassWindow(u32 micros)
+{
+	std::lock_guard<std::mutex> lock(mFramesLock);
+
+	mPassWindow = micros;
+}
+
+bool CommonCanSender::getPeriodStats(const std::vector<u32> &ids,
+		PeriodStats &stats) const
+{
+	std::lock_guard<std::mutex> lock(mFramesLock);
+
+	auto found = mRingIndex.find(ids);
+
+	if (found == mRingIndex.end())
+		return false;
+
+	stats = mFrameRings[found->second].getPeriodStats();
+
 	return true;
 }
 
+u32 CommonCanSender::getArbitrationKey(const CanFrame &frame)
+{
+	u32 id = frame.getId();
+
+	if (!frame.isExtendedFormat())
+		return (id & 0x7FF) << 20;
+
+	// Base identifier, then the recessive SRR and IDE bits and the identifier
+	// extension
+	return (((id >> 18) & 0x7FF) << 20) | (0x3 << 18) | (id & 0x3FFFF);
+}
+
+void CommonCanSender::removeRing(size_t index)
+{
+	mRingIndex.erase(getIds(mFrameRings[index].getFrames()));
+
+	// The last ring takes the place of the removed one
+	if (index + 1 != mFrameRings.size()) {
+		mFrameRings[index] = std::move(mFrameRings.back());
+		mRingIndex[getIds(mFrameRings[index].getFrames())] = index;
+	}
+
+	mFrameRings.pop_back();
+
+	rebuildSchedule();
+}
+
 void CommonCanSender::unSendFrame(u32 id)
 {
 	std::vector<u32> ids;
@@ -151,118 +383,156 @@ void CommonCanSender::unSendFrame(u32 id)
 	unSendFrames(ids);
 }
 
+void CommonCanSender::rebuildSchedule()
+{
+	mSchedule.resize(mFrameRings.size());
+
+	for (size_t i = 0; i < mSchedule.size(); ++i) {
+		mSchedule[i] = i;
+	}
+
+	std::make_heap(mSchedule.begin(), mSchedule.end(),
+				   RingDeadlineGreater(mFrameRings));
+}
+
+void CommonCanSender::scheduleRing(size_t index, const Utils::TimeStamp &now)
+{
+	CanFrameRing &ring = mFrameRings[index];
+
+	u32 period = std::max<u32>(ring.getCurrentPeriod(), 1);
+
+	// The next frame is due one period after the time in which the current
+	// one should have been sent, to avoid accumulating the delays. If we are
+	// late by more than a period, the current time is taken instead.
+	Utils::TimeStamp deadline = ring.getDeadline() + period;
+
+	if (deadline <= now) {
+		deadline = now + period;
+	}
+
+	ring.setDeadline(deadline);
+}
+
 void CommonCanSender::run()
 {
-	timespec now, current;
-	u32 elapsed;
+	std::unique_lock<std::mutex> lock(mFramesLock);
+
+	RingDeadlineGreater comp(mFrameRings);
 
 	while (!mFinished) {
-		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (mSchedule.empty()) {
+			mWakeUp.wait(lock); // Nothing to send, sleep until a ring is added
+			continue;
+		}
 
-		mFramesLock.lock();
+		const Utils::TimeStamp &deadline =
+			mFrameRings[mSchedule.front()].getDeadline();
 
-		for (auto ring = mFrameRings.begin(); ring != mFrameRings.end();
-			 ++ring) {
-			timespec start = ring->getTxTimestamp();
+		if (deadline > Utils::TimeStamp::now()) {
+			// Sleep until the earliest deadline, or until the rings change.
+			// TimeStamp::now() counts from the epoch of the steady clock.
+			mWakeUp.wait_until(
+				lock, Clock::time_point(std::chrono::duration_cast<Clock::duration>(
+						  std::chrono::nanoseconds(deadline.getNanoSec()))));
+			continue;
+		}
 
-			elapsed = abs(Utils::getElapsedMillis(&start, &now));
+		Utils::TimeStamp now = Utils::TimeStamp::now();
+		Utils::TimeStamp limit =
+			now + Utils::TimeStamp::fromNanoSec((s64)mPassWindow * 1000);
 
-			if ((start.tv_nsec == 0 && start.tv_sec == 0) ||
-				(elapsed >= ring->getCurrentPeriod())) {
-				CanFrame &toSend = ring->getCurrentFrame();
-				if (ring->getCallback()) {
-					std::string data;
-					ring->getCallback()(toSend.getId(), data);
-					toSend.setData(data);
-				}
+		mDueFrames.clear();
+		mDueRings.clear();
+
+		// Take all the rings that are due, or about to be. They are out of
+		// the heap until the end of the pass, so that a late ring gives a
+		// single frame per pass and its frames are never reordered.
+		while (!mSchedule.empty() &&
+			   mFrameRings[mSchedule.front()].getDeadline() <= limit) {
+			std::pop_heap(mSchedule.begin(), mSchedule.end(), comp);
 
-				_sendFrame(toSend); // Backend in charge of sending the frame
-				ring->shift();		// Move to the next frame
+			mDueRings.push_back(mSchedule.back());
+			mSchedule.pop_back();
 
-				current = Utils::addMillis(
-					&start,
-					ring->getCurrentPeriod()); // Calculate the time in which
-											   // the frame should have been sent
+			CanFrameRing &ring = mFrameRings[mDueRings.back()];
 
-				elapsed = abs(Utils::getElapsedMillis(&current, &now));
+			if (ring.isRoundStart())
+				ring.measureRound(now);
 
-				// Does the calculated time (current) differ from the current
-				// one (now) more than the period?
+			CanFrame &toSend = ring.getCurrentFrame();
+			if (ring.getRawCallback()) {
+				// Written in place in the frame
+				size_t length = toSend.getMaxDataLength();
+				ring.getRawCallback()(toSend.getId(), toSend.getRawData(),
+									  length);
 
-				if (elapsed < ring->getCurrentPeriod()) {
-					ring->setTxTimestamp(current); // If not, the calculated
-												   // time will be the timestamp
-				} else {
-					ring->setTxTimestamp(
-						now); // If so, the current time will be the timestamp
+				// Only the buffer is sent, the error is notified once the
+				// lock is released
+				if (!toSend.setDataLength(length)) {
+					toSend.setDataLength(toSend.getMaxDataLength());
+					mPassErrors.push_back(toSend);
 				}
+			} else if (ring.getCallback()) {
+				mCallbackData.clear(); // Keeps the capacity
+				ring.getCallback()(toSend.getId(), mCallbackData);
+				toSend.setData(mCallbackData);
 			}
-		}
 
-		mFramesLock.unlock();
+			mDueFrames.push_back(toSend); // Sent at the end of the pass
+			ring.shift();				  // Move to the next frame
 
-		usleep(1000);
-	}
-}
+			scheduleRing(mDueRings.back(), now);
+		}
 
-void CommonCanSender::unSendFrames(const std::vector<u32> &ids)
-{
-	// Check if a frame with the same id is being sent
-	auto found = mFrameRings.end();
+		for (auto index = mDueRings.begin(); index != mDueRings.end();
+			 ++index) {
+			mSchedule.push_back(*index);
+			std::push_heap(mSchedule.begin(), mSchedule.end(), comp);
+		}
 
-	// The access is concurrent but only for reading, not necessary to lock the
-	// mutex.
-	for (auto iter = mFrameRings.begin(); iter != mFrameRings.end(); ++iter) {
-		if (iter->getFrames().size() != ids.size())
-			continue;
+		// In the order they would win the arbitration, regardless of the order
+		// in which the rings were added. One frame per ring, so only frames of
+		// different rings are reordered.
+		std::stable_sort(mDueFrames.begin(), mDueFrames.end(),
+						 [](const CanFrame &a, const CanFrame &b) {
+							 return getArbitrationKey(a) < getArbitrationKey(b);
+						 });
 
-		found = iter;
+		lock.unlock();
 
-		for (auto iter2 = iter->getFrames().begin();
-			 iter2 != iter->getFrames().end(); ++iter2) {
-			if (iter2->getId() != ids[iter2 - iter->getFrames().begin()]) {
-				found = mFrameRings.end();
-				break;
-			}
+		for (auto frame = mPassErrors.begin(); frame != mPassErrors.end();
+			 ++frame) {
+			notifySendError(*frame, EMSGSIZE);
 		}
 
-		if (found != mFrameRings.end())
-			break;
-	}
+		mPassErrors.clear();
 
-	// To modify, lock the mutex
-	mFramesLock.lock();
+		// Backend in charge of sending all the frames due in this pass
+		size_t sent = _sendFrames(mDueFrames.data(), mDueFrames.size());
 
-	if (found != mFrameRings.end()) {
-		mFrameRings.erase(found);
-	}
+		if (mBusStatistics)
+			mBusStatistics->addFrames(mDueFrames.data(), sent);
 
-	mFramesLock.unlock();
+		lock.lock();
+	}
 }
 
-bool CommonCanSender::isSent(const std::vector<u32> &ids)
+void CommonCanSender::unSendFrames(const std::vector<u32> &ids)
 {
-	bool found = false;
-
-	for (auto iter = mFrameRings.begin(); iter != mFrameRings.end(); ++iter) {
-		if (iter->getFrames().size() != ids.size())
-			continue;
+	std::lock_guard<std::mutex> lock(mFramesLock);
 
-		found = true;
-
-		for (auto iter2 = iter->getFrames().begin();
-			 iter2 != iter->getFrames().end(); ++iter2) {
-			if (iter2->getId() != ids[iter2 - iter->getFrames().begin()]) {
-				found = false;
-				break;
-			}
-		}
+	auto found = mRingIndex.find(ids);
 
-		if (found)
-			return true;
+	if (found != mRingIndex.end()) {
+		removeRing(found->second);
 	}
+}
+
+bool CommonCanSender::isSent(const std::vector<u32> &ids)
+{
+	std::lock_guard<std::mutex> lock(mFramesLock);
 
-	return false;
+	return mRingIndex.find(ids) != mRingIndex.end();
 }
 
 bool CommonCanSender::isSent(u32 id)
@@ -7,12 +7,85 @@
 
 #include <ICanHelper.h>
 
+#include <stdexcept>
+
 #include <Backends/PeakCan/PeakCanHelper.h>
 #include <Backends/Sockets/SocketCanHelper.h>
+#include <Backends/Virtual/VirtualCanHelper.h>
 
 namespace Can
 {
 std::map<std::string /*Interface*/, ICanHelper *> ICanHelper::mHelpers;
+std::map<std::string /*Interface*/, ICanHelper::Tuning> ICanHelper::mTunings;
+
+namespace
+{
+void tune(const std::map<std::string, ICanHelper::Tuning> &tunings,
+		  const std::string &interface, ICanHelper *canHelper)
+{
+	auto tuning = tunings.find(interface);
+
+	if (tuning == tunings.end())
+		tuning = tunings.find("");
+
+	if (tuning != tunings.end())
+		canHelper->applyTuning(tuning->second);
+}
+
+// Whole decimal number not lower than the minimum
+bool parseNumber(const std::string &value, int min, int &number)
+{
+	size_t parsed = 0;
+	int aux;
+
+	try {
+		aux = std::stoi(value, &parsed);
+	} catch (std::logic_error &) {
+		return false;
+	}
+
+	if (parsed != value.size() || aux < min)
+		return false;
+
+	number = aux;
+
+	return true;
+}
+} // namespace
+
+bool ICanHelper::Tuning::parseOption(const std::string &name,
+									 const std::string &value)
+{
+	if (name == "rcvbuf")
+		return parseNumber(value, 0, rcvBuf);
+
+	if (name == "sndbuf")
+		return parseNumber(value, 0, sndBuf);
+
+	if (name == "busy-poll")
+		return parseNumber(value, 0, busyPoll);
+
+	if (name == "cpu")
+		return parseNumber(value, -1, rxCpu);
+
+	if (name == "irq-cpu")
+		return parseNumber(value, -1, irqCpu);
+
+	if (name == "force-buffers") {
+		forceBuffers = true;
+		return true;
+	}
+
+	return false;
+}
+
+bool ICanHelper::applyTuning(const Tuning &tuning)
+{
+	mRxCpu = tuning.rxCpu;
+
+	return tuning.rcvBuf == 0 && tuning.sndBuf == 0 && tuning.busyPoll == 0 &&
+		   tuning.irqCpu == -1;
+}
 
 const std::map<std::string, ICanHelper *> &
 ICanHelper::createCanHelpers(u32 bitrate)
@@ -26,6 +99,7 @@ ICanHelper::createCanHelpers(u32 bitrate)
 			ICanHelper *canHelper = new Sockets::SocketCanHelper;
 
 			if (canHelper->initialize(*iter, bitrate)) {
+				tune(mTunings, *iter, canHelper);
 				mHelpers[*iter] = canHelper;
 			} else {
 				delete canHelper;
@@ -40,6 +114,22 @@ ICanHelper::createCanHelpers(u32 bitrate)
 			ICanHelper *canHelper = new PeakCan::PeakCanHelper;
 
 			if (canHelper->initialize(*iter, bitrate)) {
+				tune(mTunings, *iter, canHelper);
+				mHelpers[*iter] = canHelper;
+			} else {
+				delete canHelper;
+			}
+		}
+
+		std::set<std::string> virtualIfaces =
+			Virtual::VirtualCanHelper::getCanIfaces();
+
+		for (auto iter = virtualIfaces.begin(); iter != virtualIfaces.end();
+			 ++iter) {
+			ICanHelper *canHelper = new Virtual::VirtualCanHelper;
+
+			if (canHelper->initialize(*iter, bitrate)) {
+				tune(mTunings, *iter, canHelper);
 				mHelpers[*iter] = canHelper;
 			} else {
 				delete canHelper;
@@ -74,6 +164,11 @@ std::set<std::string> ICanHelper::getInterfaces()
 
 	retVal.insert(peakCanIfaces.begin(), peakCanIfaces.end());
 
+	std::set<std::string> virtualIfaces =
+		Virtual::VirtualCanHelper::getCanIfaces();
+
+	retVal.insert(virtualIfaces.begin(), virtualIfaces.end());
+
 	return retVal;
 }
 
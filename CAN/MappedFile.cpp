@@ -0,0 +1,68 @@
+/*
+ * MappedFile.cpp
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <MappedFile.h>
+
+namespace Can
+{
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string &path)
+{
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+
+	if (fstat(fd, &info) < 0 || !S_ISREG(info.st_mode)) {
+		::close(fd);
+		return false;
+	}
+
+	if (info.st_size > 0) {
+		void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (data == MAP_FAILED) {
+			::close(fd);
+			return false;
+		}
+
+		// Mostly read from the beginning to the end
+		madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+		mData = (const char *)data;
+		mSize = info.st_size;
+	}
+
+	// The mapping stays valid after closing the descriptor
+	::close(fd);
+
+	mModificationTime =
+		(s64)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+	mOpen = true;
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mData)
+		munmap((void *)mData, mSize);
+
+	mData = nullptr;
+	mSize = 0;
+	mModificationTime = 0;
+	mOpen = false;
+}
+
+} /* namespace Can */
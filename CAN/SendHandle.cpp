@@ -0,0 +1,50 @@
+/*
+ * SendHandle.cpp
+ */
+
+#include "SendHandle.h"
+
+namespace Can
+{
+bool FramePayloads::publish(const std::vector<CanFrame> &frames)
+{
+	std::lock_guard<std::mutex> lock(mWriteLock);
+
+	std::vector<CanFrame> &back = mBuffer.back();
+
+	if (frames.size() != back.size())
+		return false;
+
+	for (size_t i = 0; i < frames.size(); ++i) {
+		if (frames[i].getId() != back[i].getId())
+			return false;
+	}
+
+	for (size_t i = 0; i < frames.size(); ++i) {
+		back[i].setFdFormat(frames[i].isFdFormat());
+		back[i].setBitrateSwitch(frames[i].isBitrateSwitch());
+		back[i].setErrorStateIndicator(frames[i].isErrorStateIndicator());
+		back[i].setData(frames[i].getRawData(), frames[i].getDataLength());
+	}
+
+	mBuffer.publish();
+
+	return true;
+}
+
+bool SendHandle::updateFrames(const std::vector<CanFrame> &frames) const
+{
+	std::shared_ptr<FramePayloads> payloads = mPayloads.lock();
+
+	if (!payloads)
+		return false;
+
+	return payloads->publish(frames);
+}
+
+bool SendHandle::updateFrame(const CanFrame &frame) const
+{
+	return updateFrames(std::vector<CanFrame>(1, frame));
+}
+
+} /* namespace Can */
@@ -0,0 +1,416 @@
+/*
+ * TRCParser.cpp
+ */
+
+#include <string.h>
+
+#include <string>
+
+#include <TRCParser.h>
+
+#define TABULATION_CHAR '\t'
+#define WHITE_SPACE_CHAR ' '
+#define END_OF_LINE_CHAR '\n'
+#define SEMI_COLON_CHAR ';'
+#define PARENTHESIS_CHAR ')'
+#define RETURN_CHAR '\r'
+#define DOT_CHAR '.'
+#define MINUS_CHAR '-'
+
+#define FILE_VERSION_TAG ";$FILEVERSION="
+#define COLUMNS_TAG ";$COLUMNS="
+
+// Columns of the TRC format, as defined by the $COLUMNS tag (version 2.x)
+#define COLUMN_NUMBER 'N'
+#define COLUMN_OFFSET 'O'
+#define COLUMN_TYPE 'T'
+#define COLUMN_BUS 'B'
+#define COLUMN_ID 'I'
+#define COLUMN_DIRECTION 'd'
+#define COLUMN_RESERVED 'R'
+#define COLUMN_LENGTH 'l'
+#define COLUMN_DLC 'L'
+#define COLUMN_DATA 'D'
+
+// Layout of the version 1.1 (no message type column)
+#define COLUMNS_V1 "NOdIlD"
+// Default layout of the version 2.x when no $COLUMNS tag is present
+#define COLUMNS_V2 "NOTIdlD"
+
+// Decimals of the offset (millis) kept in the timestamp (nanos)
+#define OFFSET_DECIMALS 6
+
+#define INVALID_DIGIT 0xFF
+
+namespace Can
+{
+namespace
+{
+// Value of the hexadecimal digits, INVALID_DIGIT for any other character
+class HexDigits
+{
+  private:
+	u8 mValues[256];
+
+  public:
+	HexDigits()
+	{
+		memset(mValues, INVALID_DIGIT, sizeof(mValues));
+
+		for (u8 i = 0; i < 10; ++i) {
+			mValues['0' + i] = i;
+		}
+
+		for (u8 i = 0; i < 6; ++i) {
+			mValues['A' + i] = mValues['a' + i] = 10 + i;
+		}
+	}
+
+	u8 operator[](char c) const { return mValues[(u8)c]; }
+};
+
+const HexDigits hexDigits;
+
+inline const char *skipLine(const char *pos, const char *end)
+{
+	const char *eol =
+		(const char *)memchr(pos, END_OF_LINE_CHAR, end - pos);
+
+	return eol ? eol + 1 : end;
+}
+
+inline bool parseDec(const char *&pos, const char *end, u32 &value)
+{
+	const char *start = pos;
+	u64 result = 0;
+
+	for (; pos < end; ++pos) {
+		u32 digit = (u8)*pos - '0';
+
+		if (digit > 9)
+			break;
+
+		result = result * 10 + digit;
+
+		if (result > 0xFFFFFFFF)
+			return false;
+	}
+
+	value = (u32)result;
+
+	return pos != start;
+}
+
+inline bool parseHex(const char *&pos, const char *end, u32 &value)
+{
+	const char *start = pos;
+	u64 result = 0;
+
+	for (; pos < end; ++pos) {
+		u8 digit = hexDigits[*pos];
+
+		if (digit == INVALID_DIGIT)
+			break;
+
+		result = (result << 4) | digit;
+
+		if (result > 0xFFFFFFFF)
+			return false;
+	}
+
+	value = (u32)result;
+
+	return pos != start;
+}
+
+/*
+ * The offset is given in millis with a fractional part. It is converted
+ * with integers, rounding to the nanosecond.
+ */
+inline bool parseOffset(const char *&pos, const char *end, s64 &nanos)
+{
+	bool negative = (pos < end && *pos == MINUS_CHAR);
+
+	if (negative)
+		++pos;
+
+	const char *start = pos;
+	s64 millis = 0, fraction = 0;
+	u32 decimals = 0;
+
+	for (; pos < end; ++pos) {
+		u32 digit = (u8)*pos - '0';
+
+		if (digit > 9)
+			break;
+
+		millis = millis * 10 + digit;
+	}
+
+	bool integer = (pos != start);
+
+	if (pos < end && *pos == DOT_CHAR) {
+		++pos;
+
+		for (; pos < end; ++pos) {
+			u32 digit = (u8)*pos - '0';
+
+			if (digit > 9)
+				break;
+
+			if (decimals < OFFSET_DECIMALS) {
+				fraction = fraction * 10 + digit;
+			} else if (decimals == OFFSET_DECIMALS && digit >= 5) {
+				++fraction; // Round the last digit kept
+			}
+
+			++decimals;
+		}
+	}
+
+	if (!integer && decimals == 0)
+		return false;
+
+	for (; decimals < OFFSET_DECIMALS; ++decimals) {
+		fraction *= 10;
+	}
+
+	nanos = millis * 1000000 + fraction;
+
+	if (negative)
+		nanos = -nanos;
+
+	return true;
+}
+} // namespace
+
+bool TRCParser::parseHeader(const char *begin, const char *end)
+{
+	std::string version = "1.1";
+	std::string columns;
+
+	// The header is made of the comment lines at the beginning of the file
+	for (const char *pos = begin; pos < end && *pos == SEMI_COLON_CHAR;) {
+		const char *next = skipLine(pos, end);
+		std::string line(pos, next);
+
+		pos = next;
+
+		while (!line.empty() &&
+			   (line.back() == END_OF_LINE_CHAR || line.back() == RETURN_CHAR))
+			line.pop_back();
+
+		if (line.compare(0, strlen(FILE_VERSION_TAG), FILE_VERSION_TAG) == 0) {
+			version = line.substr(strlen(FILE_VERSION_TAG));
+		} else if (line.compare(0, strlen(COLUMNS_TAG), COLUMNS_TAG) == 0) {
+			columns = line.substr(strlen(COLUMNS_TAG));
+		}
+	}
+
+	mMajorVersion = version.empty() ? 1 : (version[0] - '0');
+
+	if (mMajorVersion <= 1) {
+		mColumns.assign(COLUMNS_V1, COLUMNS_V1 + strlen(COLUMNS_V1));
+		return true;
+	}
+
+	if (columns.empty()) {
+		mColumns.assign(COLUMNS_V2, COLUMNS_V2 + strlen(COLUMNS_V2));
+		return true;
+	}
+
+	mColumns.clear();
+
+	for (auto c = columns.begin(); c != columns.end(); ++c) {
+		switch (*c) {
+		case COLUMN_NUMBER:
+		case COLUMN_OFFSET:
+		case COLUMN_TYPE:
+		case COLUMN_BUS:
+		case COLUMN_ID:
+		case COLUMN_DIRECTION:
+		case COLUMN_RESERVED:
+		case COLUMN_LENGTH:
+		case COLUMN_DLC:
+		case COLUMN_DATA:
+			mColumns.push_back(*c);
+			break;
+		case ',':
+		case WHITE_SPACE_CHAR:
+			break;
+		default:
+			return false; // Unsupported column
+		}
+	}
+
+	// The data bytes must be the last column
+	return !mColumns.empty() && mColumns.back() == COLUMN_DATA;
+}
+
+TRCParser::Result TRCParser::parseLine(const char *&pos, const char *end,
+									   u32 &number, Utils::TimeStamp &tStamp,
+									   CanFrame &frame) const
+{
+	u32 id = 0, length = 0, aux;
+	s64 time = 0;
+
+	bool fdFormat = false, brs = false, esi = false;
+
+	// The bytes are written in place, the length is checked once the format
+	// of the frame is known
+	u8 *data = frame.getRawData();
+	size_t dataLength = 0;
+
+	size_t column = 0;
+	bool failed = false;
+
+	number = 0;
+
+	while (pos < end) {
+		char c = *pos;
+
+		if (c == WHITE_SPACE_CHAR || c == TABULATION_CHAR) {
+			++pos;
+			continue;
+		}
+
+		if (c == SEMI_COLON_CHAR) { // Skip until end of line
+			pos = skipLine(pos, end);
+			continue;
+		}
+
+		if (c == END_OF_LINE_CHAR) {
+			++pos;
+			break;
+		}
+
+		if (c == RETURN_CHAR) {
+			failed = (pos + 1 == end || pos[1] != END_OF_LINE_CHAR);
+
+			if (!failed)
+				pos += 2;
+			break;
+		}
+
+		if (column >= mColumns.size()) { // Unexpected token
+			failed = true;
+			break;
+		}
+
+		switch (mColumns[column]) {
+		case COLUMN_NUMBER:
+			failed = !parseDec(pos, end, number);
+
+			// The parenthesis is mandatory in version 1.x only
+			if (pos < end && *pos == PARENTHESIS_CHAR) {
+				++pos;
+			} else if (mMajorVersion == 1) {
+				failed = true;
+			}
+			break;
+
+		case COLUMN_OFFSET:
+			failed = !parseOffset(pos, end, time);
+			break;
+
+		case COLUMN_TYPE:
+			if (end - pos < 2) {
+				failed = true;
+				break;
+			}
+
+			if (pos[0] == 'D' && pos[1] == 'T') {
+				fdFormat = false;
+			} else if (pos[0] == 'F' && pos[1] == 'D') {
+				fdFormat = true;
+			} else if (pos[0] == 'F' && pos[1] == 'B') {
+				fdFormat = brs = true;
+			} else if (pos[0] == 'F' && pos[1] == 'E') {
+				fdFormat = esi = true;
+			} else if (pos[0] == 'B' && pos[1] == 'I') {
+				fdFormat = brs = esi = true;
+			} else {
+				// Not a data frame (status, error or remote request). It is
+				// skipped as an empty line.
+				pos = skipLine(pos, end);
+				return EMPTY;
+			}
+
+			pos += 2;
+			break;
+
+		case COLUMN_DIRECTION:
+			failed = (end - pos < 2);
+			pos += (failed ? end - pos : 2);
+			break;
+
+		case COLUMN_RESERVED:
+			++pos;
+			break;
+
+		case COLUMN_BUS:
+			failed = !parseDec(pos, end, aux);
+			break;
+
+		case COLUMN_ID:
+			failed = !parseHex(pos, end, id);
+			break;
+
+		case COLUMN_LENGTH:
+			failed = !parseDec(pos, end, length);
+			break;
+
+		case COLUMN_DLC:
+			failed = !parseDec(pos, end, aux);
+			length = CanFrame::dlcToLength(aux);
+			break;
+
+		case COLUMN_DATA:
+			failed = !parseHex(pos, end, aux) || aux > 0xFF ||
+					 dataLength >= MAX_CANFD_DATA_SIZE;
+
+			if (!failed)
+				data[dataLength++] = (u8)aux;
+
+			if (dataLength < length) {
+				--column; // Stay in the data column
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		if (failed)
+			break;
+
+		++column;
+	}
+
+	if (failed) {
+		pos = skipLine(pos, end);
+		return ERROR;
+	}
+
+	if (column == 0)
+		return EMPTY;
+
+	// The line is complete when all the columns up to the data have been read
+	if (column + 1 < mColumns.size() || dataLength != length)
+		return ERROR;
+
+	frame.setExtendedFormat(true);
+	frame.setId(id);
+	frame.setFdFormat(fdFormat);
+	frame.setBitrateSwitch(brs);
+	frame.setErrorStateIndicator(esi);
+
+	if (!frame.setDataLength(dataLength))
+		return ERROR;
+
+	tStamp = Utils::TimeStamp::fromNanoSec(time);
+
+	return FRAME;
+}
+
+} /* namespace Can */
@@ -5,58 +5,128 @@
  *      Author: root
  */
 
-#include <limits>
-#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <condition_variable>
 
 #include "TRCReader.h"
 
-#define TABULATION_CHAR '\t'
-#define WHITE_SPACE_CHAR ' '
-#define END_OF_LINE_CHAR '\n'
-#define SEMI_COLON_CHAR ';'
-#define PARENTHESIS_CHAR ')'
-#define RETURN_CHAR '\r'
-
-#define PARSE_STATE_GET_POSITION 0
-#define PARSE_STATE_GET_TIME 1
-#define PARSE_STATE_GET_TYPE 2
-#define PARSE_STATE_GET_ID 3
-#define PARSE_STATE_GET_LENGTH 4
-#define PARSE_STATE_GET_DATA 5
-#define PARSE_STATE_GET_END 6
-#define PARSE_STATE_GET_ERROR 7
+// Identifies the index files, with the version of their layout
+#define TRC_INDEX_MAGIC "TRCIDX01"
+#define TRC_INDEX_MAGIC_SIZE 8
 
 namespace Can
 {
-TRCReader::TRCReader() : mCurrentPos(0), mTotalFrames(0) {}
+namespace
+{
+// Frames of a chunk of the file parsed by one of the threads
+struct ParsedChunk {
+	std::vector<CanFrame> frames;
+	std::vector<Utils::TimeStamp> tStamps;
+	u32 firstNumber; // 0 if there are no numbered records
+	u32 lastNumber;
+	bool valid; // No malformed record nor missing number inside
+	bool done;
+
+	ParsedChunk() : firstNumber(0), lastNumber(0), valid(true), done(false) {}
+
+	void clear()
+	{
+		frames.clear();
+		tStamps.clear();
+		firstNumber = lastNumber = 0;
+		valid = true;
+		done = false;
+	}
+};
 
-TRCReader::TRCReader(const std::string &path) : mCurrentPos(0), mTotalFrames(0)
+/*
+ * Parses the lines from begin to end, stopping before the first malformed
+ * record or the first number not following the previous one
+ */
+void parseChunk(const TRCParser &parser, const char *begin, const char *end,
+				ParsedChunk &chunk)
 {
-	loadFile(path);
+	const char *pos = begin;
+	u32 number;
+
+	chunk.frames.reserve((end - begin) / TRC_ESTIMATED_RECORD_SIZE + 1);
+	chunk.tStamps.reserve(chunk.frames.capacity());
+
+	while (pos < end) {
+		chunk.frames.emplace_back();
+		chunk.tStamps.emplace_back();
+
+		TRCParser::Result result = parser.parseLine(
+			pos, end, number, chunk.tStamps.back(), chunk.frames.back());
+
+		// Also counts the records which are not data frames
+		if (result != TRCParser::ERROR && number != 0) {
+			if (chunk.lastNumber != 0 && number != chunk.lastNumber + 1) {
+				result = TRCParser::ERROR;
+			} else {
+				if (chunk.firstNumber == 0)
+					chunk.firstNumber = number;
+				chunk.lastNumber = number;
+			}
+		}
+
+		if (result != TRCParser::FRAME) {
+			chunk.frames.pop_back();
+			chunk.tStamps.pop_back();
+		}
+
+		if (result == TRCParser::ERROR) {
+			chunk.valid = false;
+			return;
+		}
+	}
 }
+} // namespace
 
-TRCReader::~TRCReader() {}
+TRCReader::TRCReader()
+	: mCurrentPos(0), mTotalFrames(0), mExactFrames(true), mScannedFrames(0),
+	  mScannedBytes(0), mStopScan(false), mOffset(0)
+{
+}
+
+TRCReader::TRCReader(const std::string &path) : TRCReader() { loadFile(path); }
+
+TRCReader::~TRCReader() { unloadFile(); }
 
-bool TRCReader::loadFile(const std::string &path)
+bool TRCReader::loadFile(const std::string &path, LoadMode mode)
 {
 	unloadFile();
 
 	mFileName = path;
 
-	// It is important to open the file in binary mode, as in text mode,
-	// for gcc compiler in windows, the method tellg() returns incorrect size
-	mFileStream.open(path.c_str(), std::ifstream::in | std::ifstream::binary);
-
-	if (mFileStream.rdstate() & std::ios_base::failbit) {
+	if (!mFile.open(path)) {
 		unloadFile();
 		return false;
 	}
 
-	if (!checkIntegrity()) {
+	if (!mParser.parseHeader(mFile.data(), mFile.end())) {
 		unloadFile();
 		return false;
 	}
 
+	// Nor scanned by a thread, the file is parsed once by the caller
+	if (mode == MAPPED) {
+		mExactFrames = false;
+	} else if (!loadIndex()) {
+		if (mode == LAZY) {
+			mExactFrames = false;
+			mScanThread = std::thread(&TRCReader::scanInBackground, this);
+		} else if (!checkIntegrity()) {
+			unloadFile();
+			return false;
+		} else {
+			saveIndex(mIndex, mTotalFrames);
+		}
+	}
+
 	reset();
 
 	return true;
@@ -64,221 +134,471 @@ bool TRCReader::loadFile(const std::string &path)
 
 void TRCReader::unloadFile()
 {
-	if (mFileStream.is_open()) {
-		mFileStream.close();
+	if (mScanThread.joinable()) {
+		mStopScan = true;
+		mScanThread.join();
+		mStopScan = false;
 	}
 
+	mFile.close();
+
 	mFileName.clear();
 	mCurrentPos = 0;
 	mTotalFrames = 0;
+	mExactFrames = true;
+	mScannedFrames = 0;
+	mScannedBytes = 0;
+	mOffset = 0;
+	mIndex.clear();
 }
 
 void TRCReader::reset()
 {
-	mFileStream.clear();
-	mFileStream.seekg(0, mFileStream.beg);
-
+	mOffset = 0;
 	mCurrentPos = 0;
 }
 
-bool TRCReader::seekPosition(size_t pos)
+size_t TRCReader::getNumberOfFrames() const
 {
-	if (!isFileLoaded() || pos >= mTotalFrames) {
-		return false;
+	if (mExactFrames) {
+		return mTotalFrames;
 	}
 
-	if (mCurrentPos == pos) {
-		return true;
-	}
+	size_t frames = mScannedFrames;
+	size_t bytes = mScannedBytes;
 
-	mFileStream.clear();
-	mFileStream.seekg(0, mFileStream.beg);
+	if (bytes == 0) {
+		return mFile.size() / TRC_ESTIMATED_RECORD_SIZE;
+	}
 
-	mCurrentPos = 0;
+	return (size_t)((double)frames * mFile.size() / bytes);
+}
 
+template <typename Predicate>
+bool TRCReader::readUntil(size_t offset, Predicate predicate)
+{
 	bool error, empty;
 
-	while (!mFileStream.eof()) {
+	// Kept to stay where the reader was if no frame is found
+	size_t lastOffset = mOffset;
+	size_t lastPos = mCurrentPos;
+	std::pair<Utils::TimeStamp, CanFrame> lastPair = mLastReadFrameTimePair;
+
+	mOffset = offset;
+
+	while (mOffset < mFile.size()) {
 		readNextLine(error, empty);
 		if (error) {
-			return false;
+			break;
 		}
 
-		if (mCurrentPos == pos) {
+		if (!empty &&
+			predicate(mCurrentPos, mLastReadFrameTimePair.first.getNanoSec())) {
 			return true;
 		}
 	}
 
+	mOffset = lastOffset;
+	mCurrentPos = lastPos;
+	mLastReadFrameTimePair = lastPair;
+
 	return false;
 }
 
-std::pair<u64, CanFrame> TRCReader::getLastCanFrame()
+bool TRCReader::seekPosition(size_t pos)
 {
-	return mLastReadFrameTimePair;
-}
+	if (!isFileLoaded() || (mExactFrames && pos >= mTotalFrames)) {
+		return false;
+	}
 
-void TRCReader::readNextLine(bool &error, bool &empty)
-{
-	char c;
+	if (mCurrentPos == pos) {
+		return true;
+	}
 
-	double timeAux;
+	size_t offset = 0;
 
-	u32 position, id, length;
-	u64 time;
+	{
+		std::lock_guard<std::mutex> lock(mIndexLock);
 
-	std::string type;
+		// Start from the closest entry of the index before the frame
+		auto entry = std::upper_bound(mIndex.begin(), mIndex.end(), pos,
+									  [](size_t pos, const IndexEntry &entry) {
+										  return pos < entry.position;
+									  });
 
-	u32 dataAux;
+		if (entry != mIndex.begin())
+			offset = (entry - 1)->offset;
+	}
 
-	std::string data;
+	// Or from the last frame read if it is closer, e.g. the file is still
+	// being indexed
+	if (mCurrentPos < pos && mOffset > offset)
+		offset = mOffset;
 
-	error = false;
-	empty = false;
+	// The records which are not frames leave gaps between the positions
+	return readUntil(offset,
+					 [pos](size_t position, s64) { return position >= pos; });
+}
 
-	u8 state = PARSE_STATE_GET_POSITION;
+bool TRCReader::seekTime(const Utils::TimeStamp &tStamp)
+{
+	if (!isFileLoaded()) {
+		return false;
+	}
 
-	mLastReadFrameTimePair.first = 0;
-	mLastReadFrameTimePair.second.clear();
+	s64 time = tStamp.getNanoSec();
+	size_t offset = 0;
 
-	while (mFileStream.get(c)) {
-		if (c == WHITE_SPACE_CHAR || c == TABULATION_CHAR)
-			continue;
+	{
+		std::lock_guard<std::mutex> lock(mIndexLock);
 
-		if (c == SEMI_COLON_CHAR) { // Skip until end of line
-			mFileStream.ignore(std::numeric_limits<std::streamsize>::max(),
-							   END_OF_LINE_CHAR);
-			continue;
-		}
+		// Start from the last entry of the index before the time
+		auto entry = std::lower_bound(
+			mIndex.begin(), mIndex.end(), time,
+			[](const IndexEntry &entry, s64 time) { return entry.time < time; });
 
-		if (c == END_OF_LINE_CHAR)
-			break;
+		if (entry != mIndex.begin())
+			offset = (entry - 1)->offset;
+	}
 
-		if (c == RETURN_CHAR) {
-			mFileStream.get(c);
-			if (c == END_OF_LINE_CHAR) {
-				break;
-			} else {
-				state = PARSE_STATE_GET_ERROR;
-			}
-		}
+	return readUntil(offset, [time](size_t, s64 frameTime) {
+		return frameTime >= time;
+	});
+}
+
+std::pair<Utils::TimeStamp, CanFrame> TRCReader::getLastCanFrame()
+{
+	return mLastReadFrameTimePair;
+}
 
-		int pos = mFileStream.tellg();
+void TRCReader::readNextLine(bool &error, bool &empty)
+{
+	const char *pos = mFile.data() + mOffset;
+	u32 number;
 
-		pos -= 1;
+	TRCParser::Result result =
+		mParser.parseLine(pos, mFile.end(), number, mLastReadFrameTimePair.first,
+						  mLastReadFrameTimePair.second);
 
-		mFileStream.seekg(pos);
+	mOffset = pos - mFile.data();
 
-		switch (state) {
-		case PARSE_STATE_GET_POSITION:
-			mFileStream >> std::dec >> position;
-			mFileStream.get(c);
+	error = (result == TRCParser::ERROR);
+	empty = (result == TRCParser::EMPTY);
 
-			if (c != PARENTHESIS_CHAR)
-				state = PARSE_STATE_GET_ERROR;
-			break;
+	if (result != TRCParser::FRAME) {
+		mLastReadFrameTimePair.first = Utils::TimeStamp();
+		mLastReadFrameTimePair.second.clear();
+		return;
+	}
 
-		case PARSE_STATE_GET_TIME:
+	mCurrentPos = number - 1;
+}
 
-			mFileStream >> std::dec >> timeAux;
-			timeAux *= 1000;
-			time = (u64)timeAux;
+bool TRCReader::scanFile(std::vector<IndexEntry> &index, size_t &frames)
+{
+	const char *pos = mFile.data();
+	size_t scanned = 0;
 
-			break;
+	u32 number;
+	Utils::TimeStamp tStamp;
+	CanFrame frame;
 
-		case PARSE_STATE_GET_TYPE:
-			mFileStream.get(c);
-			type.append(1, c);
-			mFileStream.get(c);
-			type.append(1, c);
-			break;
+	frames = 0;
 
-		case PARSE_STATE_GET_ID:
-			mFileStream >> std::hex >> id;
-			break;
-		case PARSE_STATE_GET_LENGTH:
-			mFileStream >> length;
-			break;
-		case PARSE_STATE_GET_DATA:
-			mFileStream >> std::hex >> dataAux;
+	while (pos < mFile.end() && !mStopScan) {
+		const char *line = pos;
 
-			if (dataAux <= 0xFF) {
-				data.push_back((char)dataAux);
-			} else {
-				state = PARSE_STATE_GET_ERROR;
-				break;
-			}
-			if (data.size() < length) {
-				--state;
+		switch (mParser.parseLine(pos, mFile.end(), number, tStamp, frame)) {
+		case TRCParser::ERROR:
+			return false;
+
+		case TRCParser::FRAME:
+			// Counted up to the position of the frame, as the positions
+			frames = number;
+
+			if (scanned % TRC_INDEX_INTERVAL == 0) {
+				index.push_back({(u64)(line - mFile.data()), number - 1,
+								 tStamp.getNanoSec()});
 			}
 
+			if (++scanned % TRC_SCAN_PROGRESS_INTERVAL == 0) {
+				mScannedFrames = frames;
+				mScannedBytes = pos - mFile.data();
+			}
 			break;
-		case PARSE_STATE_GET_END:
+
 		default:
 			break;
 		}
+	}
 
-		if (mFileStream.rdstate() == std::ios_base::failbit ||
-			mFileStream.rdstate() ==
-				std::ios_base::badbit) { // If error parsing stream...
-			mFileStream.clear();		 // Clear bit state
-			mFileStream.ignore(std::numeric_limits<std::streamsize>::max(),
-							   END_OF_LINE_CHAR); // Just go until end of line
-			mFileStream.get(c);					  // Get end of line
+	return true;
+}
 
-			state = PARSE_STATE_GET_ERROR;
-		}
+bool TRCReader::checkIntegrity()
+{
+	size_t frames;
+	bool valid = scanFile(mIndex, frames);
 
-		if (state == PARSE_STATE_GET_ERROR) {
-			break;
-		}
+	mTotalFrames = frames;
 
-		++state;
-	}
+	return valid;
+}
 
-	if (state != PARSE_STATE_GET_END && state != PARSE_STATE_GET_POSITION) {
-		error = true;
+void TRCReader::scanInBackground()
+{
+	std::vector<IndexEntry> index;
+	size_t frames;
+
+	bool valid = scanFile(index, frames);
+
+	if (mStopScan) {
 		return;
 	}
 
-	if (state == PARSE_STATE_GET_POSITION) {
-		empty = true;
-		return;
+	{
+		std::lock_guard<std::mutex> lock(mIndexLock);
+		mIndex.swap(index);
 	}
 
-	if (data.size() != length) {
-		error = true;
-		return;
+	// Up to the malformed record, if any
+	mTotalFrames = frames;
+	mExactFrames = true;
+
+	// The index is only read from now on
+	if (valid) {
+		saveIndex(mIndex, frames);
+	}
+}
+
+/*
+ * Layout of the index files (host byte order): magic, size and modification
+ * time of the file, number of frames, number of entries and the entries.
+ */
+bool TRCReader::loadIndex()
+{
+	std::string path = mFileName + TRC_INDEX_EXTENSION;
+	FILE *file = fopen(path.c_str(), "rb");
+
+	if (!file) {
+		return false;
+	}
+
+	char magic[TRC_INDEX_MAGIC_SIZE];
+	u64 size, frames, entries;
+	s64 modificationTime;
+
+	bool valid =
+		fread(magic, sizeof(magic), 1, file) == 1 &&
+		memcmp(magic, TRC_INDEX_MAGIC, TRC_INDEX_MAGIC_SIZE) == 0 &&
+		fread(&size, sizeof(size), 1, file) == 1 &&
+		fread(&modificationTime, sizeof(modificationTime), 1, file) == 1 &&
+		fread(&frames, sizeof(frames), 1, file) == 1 &&
+		fread(&entries, sizeof(entries), 1, file) == 1 &&
+		size == mFile.size() &&
+		modificationTime == mFile.getModificationTime() &&
+		entries <= frames;
+
+	if (valid) {
+		mIndex.resize(entries);
+		valid = (entries == 0 ||
+				 fread(mIndex.data(), sizeof(IndexEntry), entries, file) ==
+					 entries);
+	}
+
+	fclose(file);
+
+	if (!valid) {
+		mIndex.clear();
+		return false;
 	}
 
-	mCurrentPos = position - 1;
+	mTotalFrames = frames;
+
+	return true;
+}
+
+void TRCReader::saveIndex(const std::vector<IndexEntry> &index,
+						  size_t frames) const
+{
+	std::string path = mFileName + TRC_INDEX_EXTENSION;
+	std::string tmpPath = path + ".tmp";
+
+	// Not an error if the directory is read only, the file is just checked
+	// again the next time
+	FILE *file = fopen(tmpPath.c_str(), "wb");
 
-	CanFrame frame(true, id, data);
+	if (!file) {
+		return;
+	}
 
-	mLastReadFrameTimePair.first = time;
-	mLastReadFrameTimePair.second = frame;
+	u64 size = mFile.size();
+	s64 modificationTime = mFile.getModificationTime();
+	u64 totalFrames = frames;
+	u64 entries = index.size();
+
+	bool written =
+		fwrite(TRC_INDEX_MAGIC, TRC_INDEX_MAGIC_SIZE, 1, file) == 1 &&
+		fwrite(&size, sizeof(size), 1, file) == 1 &&
+		fwrite(&modificationTime, sizeof(modificationTime), 1, file) == 1 &&
+		fwrite(&totalFrames, sizeof(totalFrames), 1, file) == 1 &&
+		fwrite(&entries, sizeof(entries), 1, file) == 1 &&
+		(entries == 0 ||
+		 fwrite(index.data(), sizeof(IndexEntry), entries, file) == entries);
+
+	written = (fclose(file) == 0) && written;
+
+	// Replaced at once, not to be read while being written
+	if (!written || rename(tmpPath.c_str(), path.c_str()) != 0) {
+		remove(tmpPath.c_str());
+	}
 }
 
-bool TRCReader::checkIntegrity()
+bool TRCReader::parseFrames(const OnTRCFramesCallback &callback,
+							 size_t threads, size_t chunkSize) const
 {
-	bool error, empty;
+	if (!isFileLoaded()) {
+		return false;
+	}
 
-	while (!mFileStream.eof()) {
-		readNextLine(error, empty);
-		if (error) {
-			return false;
+	if (threads == 0) {
+		threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	// The chunks end at the end of a line
+	std::vector<const char *> bounds(1, mFile.data());
+
+	while (bounds.back() < mFile.end()) {
+		const char *bound = bounds.back() + std::max(chunkSize, (size_t)1);
+
+		if (bound >= mFile.end()) {
+			bound = mFile.end();
+		} else {
+			const char *eol =
+				(const char *)memchr(bound, '\n', mFile.end() - bound);
+			bound = eol ? eol + 1 : mFile.end();
 		}
+
+		bounds.push_back(bound);
 	}
 
-	mTotalFrames = mCurrentPos + 1;
+	size_t chunks = bounds.size() - 1;
 
-	return true;
+	threads = std::min(threads, std::max(chunks, (size_t)1));
+
+	// The chunks are parsed in a ring of slots, a slot being parsed again
+	// once its frames have been handed to the callback
+	size_t window = threads * TRC_PARALLEL_CHUNKS_AHEAD;
+	std::vector<ParsedChunk> slots(window);
+
+	std::mutex lock;
+	std::condition_variable changed;
+	size_t next = 0, delivered = 0;
+	bool stop = false;
+
+	auto worker = [&]() {
+		for (;;) {
+			size_t index;
+
+			{
+				std::unique_lock<std::mutex> guard(lock);
+
+				changed.wait(guard, [&]() {
+					return stop || next >= chunks || next < delivered + window;
+				});
+
+				if (stop || next >= chunks)
+					return;
+
+				index = next++;
+			}
+
+			ParsedChunk &chunk = slots[index % window];
+
+			parseChunk(mParser, bounds[index], bounds[index + 1], chunk);
+
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				chunk.done = true;
+			}
+
+			changed.notify_all();
+		}
+	};
+
+	std::vector<std::thread> pool;
+
+	for (size_t i = 0; i < threads; ++i) {
+		pool.emplace_back(worker);
+	}
+
+	bool ok = true;
+	u32 lastNumber = 0;
+
+	for (size_t i = 0; i < chunks && ok; ++i) {
+		ParsedChunk &chunk = slots[i % window];
+
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			changed.wait(guard, [&chunk]() { return chunk.done; });
+		}
+
+		// The first record of the chunk must follow the last one of the
+		// previous chunk
+		if (chunk.firstNumber != 0) {
+			if (lastNumber != 0 && chunk.firstNumber != lastNumber + 1) {
+				ok = false;
+				break;
+			}
+
+			lastNumber = chunk.lastNumber;
+		}
+
+		// Up to the malformed record, if any
+		if (!chunk.frames.empty()) {
+			ok = callback(chunk.frames.data(), chunk.tStamps.data(),
+						  chunk.frames.size());
+		}
+
+		ok = ok && chunk.valid;
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			chunk.clear();
+			++delivered;
+		}
+
+		changed.notify_all();
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stop = true;
+	}
+
+	changed.notify_all();
+
+	for (auto thread = pool.begin(); thread != pool.end(); ++thread) {
+		thread->join();
+	}
+
+	return ok;
 }
 
 void TRCReader::readNextCanFrame()
 {
 	bool error, empty;
-	if (!mFileStream.eof()) {
+
+	if (mOffset < mFile.size()) {
 		readNextLine(error, empty);
+
+		if (error) {
+			throw TRCReadException();
+		}
+	} else {
+		// Nothing else to read, as an empty line
+		mLastReadFrameTimePair.first = Utils::TimeStamp();
+		mLastReadFrameTimePair.second.clear();
 	}
 }
 
@@ -11,14 +11,16 @@
 #include "TRCWriter.h"
 
 #define TRC_FILE_HEADER ";$FILEVERSION=1.1\n;\n"
+#define TRC_FILE_HEADER_V2 ";$FILEVERSION=2.0\n;$COLUMNS=N,O,T,I,d,l,D\n;\n"
 
 namespace Can
 {
-TRCWriter::TRCWriter() : mCounter(0) {}
+TRCWriter::TRCWriter() : mCounter(0), mVersion(VERSION_1_1) {}
 
-TRCWriter::TRCWriter(const std::string &file) : mCounter(0)
+TRCWriter::TRCWriter(const std::string &file, Version version)
+	: mCounter(0), mVersion(version)
 {
-	open(file);
+	open(file, version);
 }
 
 TRCWriter::~TRCWriter() {}
@@ -29,11 +31,14 @@ void TRCWriter::write(const CanFrame &frame, const Utils::TimeStamp &timeStamp)
 		throw TRCWriteException();
 	}
 
+	if (frame.isFdFormat() && mVersion == VERSION_1_1) {
+		throw TRCWriteException(); // FD frames cannot be represented
+	}
+
 	std::stringstream sstr;
-	double ts = timeStamp.getSeconds() * 1000 +
-				(double)(timeStamp.getMicroSec()) / 1000;
+	double ts = (double)(timeStamp.getNanoSec()) / 1000000;
 
-	size_t size = frame.getData().length();
+	size_t size = frame.getDataLength();
 
 	sstr << ++mCounter << ")";
 
@@ -42,29 +47,45 @@ void TRCWriter::write(const CanFrame &frame, const Utils::TimeStamp &timeStamp)
 	sstr.str("");
 	sstr.clear(); // Clear state flags.
 
-	sstr << std::fixed << std::setprecision(1) << ts;
+	if (mVersion == VERSION_1_1) {
+		sstr << std::fixed << std::setprecision(1) << ts;
 
-	mFileStream << std::right << std::setw(12) << sstr.str();
+		mFileStream << std::right << std::setw(12) << sstr.str();
 
-	sstr.str("");
-	sstr.clear(); // Clear state flags.
+		sstr.str("");
+		sstr.clear(); // Clear state flags.
+
+		mFileStream << std::right << std::setw(4) << "Rx";
+	} else {
+		sstr << std::fixed << std::setprecision(3) << ts;
 
-	mFileStream << std::right << std::setw(4) << "Rx";
+		mFileStream << std::right << std::setw(14) << sstr.str();
+
+		sstr.str("");
+		sstr.clear(); // Clear state flags.
+
+		mFileStream << std::right << std::setw(3) << getType(frame);
+	}
 
 	sstr << std::setfill('0') << std::setw(8) << std::hex << std::uppercase
 		 << frame.getId();
 
-	mFileStream << std::right << std::setw(13) << sstr.str();
+	mFileStream << std::right << std::setw(mVersion == VERSION_1_1 ? 13 : 9)
+				<< sstr.str();
 
 	sstr.str("");
 	sstr.clear(); // Clear state flags.
 
+	if (mVersion != VERSION_1_1) {
+		mFileStream << std::right << std::setw(3) << "Rx";
+	}
+
 	mFileStream << std::right << std::setw(3) << size;
 
 	sstr << "  ";
 
 	for (unsigned int i = 0; i < size; ++i) {
-		u8 octet = frame.getData()[i];
+		u8 octet = frame.getRawData()[i];
 
 		sstr << std::setfill('0') << std::setw(2) << std::hex
 			 << static_cast<u32>(octet) << " ";
@@ -73,14 +94,34 @@ void TRCWriter::write(const CanFrame &frame, const Utils::TimeStamp &timeStamp)
 	mFileStream << sstr.str() << std::endl;
 }
 
-bool TRCWriter::open(const std::string &file)
+const char *TRCWriter::getType(const CanFrame &frame)
+{
+	if (!frame.isFdFormat())
+		return "DT";
+
+	if (frame.isBitrateSwitch() && frame.isErrorStateIndicator())
+		return "BI";
+
+	if (frame.isBitrateSwitch())
+		return "FB";
+
+	if (frame.isErrorStateIndicator())
+		return "FE";
+
+	return "FD";
+}
+
+bool TRCWriter::open(const std::string &file, Version version)
 {
 	close();
 
+	mVersion = version;
+
 	mFileStream.open(file.c_str(), std::ifstream::out | std::ifstream::trunc);
 
 	if (mFileStream.is_open()) {
-		mFileStream << TRC_FILE_HEADER;
+		mFileStream << (mVersion == VERSION_1_1 ? TRC_FILE_HEADER
+												: TRC_FILE_HEADER_V2);
 	}
 
 	return mFileStream.is_open();
@@ -29,6 +29,9 @@ class PeakCanReceiver : public CommonCanReceiver
 	int getFD() override;
 
 	bool receive(CanFrame &, Utils::TimeStamp &) override;
+
+	size_t receiveBatch(CanFrame *frames, Utils::TimeStamp *tStamps,
+						size_t max) override;
 };
 
 } /* namespace PeakCan */
@@ -22,6 +22,8 @@ class SocketCanHelper : public Can::ICanHelper
   private:
 	int mSock = -1;
 	bool mTimeStamp = true;
+	bool mFdFrames = false;
+	bool mHardwareTimeStamp = false;
 	std::string mInterface;
 
 	bool isUp() const;
@@ -30,6 +32,12 @@ class SocketCanHelper : public Can::ICanHelper
 	bool setBitrate(u32 bitrate) const;
 	bool isVirtual() const;
 
+	/*
+	 * IRQs of the device behind the interface
+	 */
+	std::set<int> getIrqs() const;
+	bool setIrqAffinity(int cpu) const;
+
   public:
 	SocketCanHelper();
 	virtual ~SocketCanHelper();
@@ -41,11 +49,37 @@ class SocketCanHelper : public Can::ICanHelper
 	ICanSender *allocateCanSender() override;
 	CommonCanReceiver *allocateCanReceiver() override;
 
+	/*
+	 * Alternative to allocateCanReceiver() for high frame rates: the receiver
+	 * takes the frames from a memory mapped ring shared with the kernel
+	 * instead of doing a syscall per frame. The filters are checked in user
+	 * space. Returns nullptr if the ring cannot be set up (e.g. missing
+	 * CAP_NET_RAW), the caller is in charge of the deallocation.
+	 */
+	CommonCanReceiver *allocateCanRingReceiver();
+
 	bool initialize(std::string interface, u32 bitrate) override;
 
 	void finalize() override;
 
 	bool initialized() override;
+
+	/*
+	 * Sets the buffers and busy polling of the socket of the receiver and the
+	 * sender, and routes the IRQs of the device to the given CPU
+	 */
+	bool applyTuning(const Tuning &tuning) override;
+
+	/*
+	 * Determines if CAN FD frames can be sent and received through the socket
+	 */
+	bool fdFramesEnabled() const { return mFdFrames; }
+
+	/*
+	 * The receivers allocated afterwards take the raw hardware timestamps
+	 * when available instead of the software ones
+	 */
+	void setHardwareTimeStamp(bool hardware) { mHardwareTimeStamp = hardware; }
 };
 
 } // namespace Sockets
@@ -8,8 +8,18 @@
 #ifndef BACKENDS_SOCKETS_SOCKETCANRECEIVER_H_
 #define BACKENDS_SOCKETS_SOCKETCANRECEIVER_H_
 
+#include <vector>
+
 #include <CommonCanReceiver.h>
 
+// Maximum number of frames drained from the socket by a single recvmmsg call
+#define SOCKETCAN_RECV_BATCH_SIZE 64
+
+// Room for the timestamps and the drop counter (SO_RXQ_OVFL)
+#define SOCKETCAN_CTRLMSG_SIZE                                                 \
+	(CMSG_SPACE(sizeof(timeval)) + CMSG_SPACE(3 * sizeof(timespec)) +         \
+	 CMSG_SPACE(sizeof(u32)))
+
 namespace Can
 {
 namespace Sockets
@@ -22,29 +32,106 @@ class SocketCanReceiver : public CommonCanReceiver
 	 */
 	int mSock;
 	bool mTimeStamp;
+	bool mHardwareTimeStamp;
+	size_t mKernelFilters = 0; // Filters installed after being optimized
+	u32 mSocketDrops = 0;	   // Last value of the drop counter of the socket
+
+	// Socket without filters feeding the bus statistics, opened when they
+	// are attached. Unlike the reception one, shared with the sender, it
+	// also gets the frames sent from this host.
+	int mStatsSock = -1;
 
 	iovec iov;
 	msghdr msg;
 	canfd_frame frame;
 	sockaddr_can addr;
-	char ctrlmsg[CMSG_SPACE(sizeof(timeval) + 3 * sizeof(timespec) +
-							sizeof(u32))];
+	char ctrlmsg[SOCKETCAN_CTRLMSG_SIZE];
+
+	/*
+	 * Buffers for batched reception
+	 */
+	mmsghdr mBatchMsgs[SOCKETCAN_RECV_BATCH_SIZE];
+	iovec mBatchIovs[SOCKETCAN_RECV_BATCH_SIZE];
+	canfd_frame mBatchFrames[SOCKETCAN_RECV_BATCH_SIZE];
+	sockaddr_can mBatchAddrs[SOCKETCAN_RECV_BATCH_SIZE];
+	char mBatchCtrlMsgs[SOCKETCAN_RECV_BATCH_SIZE][SOCKETCAN_CTRLMSG_SIZE];
+
+	/*
+	 * Buffers to drain the statistics socket, which can be done from another
+	 * thread than the reception (pipelined mode)
+	 */
+	mmsghdr mStatsMsgs[SOCKETCAN_RECV_BATCH_SIZE];
+	iovec mStatsIovs[SOCKETCAN_RECV_BATCH_SIZE];
+	canfd_frame mStatsRawFrames[SOCKETCAN_RECV_BATCH_SIZE];
+	CanFrame mStatsFrames[SOCKETCAN_RECV_BATCH_SIZE];
+
+	/*
+	 * Takes the timestamp and the drop counter from the control messages
+	 */
+	void parseControlMessages(msghdr *hdr, Utils::TimeStamp &timestamp);
+
+	/*
+	 * Opens the statistics socket on the interface of the reception one
+	 */
+	bool openStatisticsSocket();
 
   public:
-	SocketCanReceiver(int sock, bool timeStamp);
+	/*
+	 * Fills canFrame from the raw frame. The size tells if it is a classic
+	 * (CAN_MTU) or a FD frame (CANFD_MTU).
+	 */
+	static void copyFrame(const canfd_frame &rawFrame, size_t size,
+						  CanFrame &canFrame);
+
+	/*
+	 * If hardwareTimeStamp is set, the raw hardware timestamp is taken when
+	 * the driver provides it, otherwise the software one.
+	 */
+	SocketCanReceiver(int sock, bool timeStamp, bool hardwareTimeStamp = false);
 	virtual ~SocketCanReceiver();
 
 	/*ICanReceiver implementation*/
 
 	bool setFilters(std::set<CanFilter> filters) override;
 
-	bool filter(u32 id) override
-	{
-		return true;
-	} // Filtering is already done in kernel space
+	/*
+	 * Number of filters installed in the socket, which can be lower than the
+	 * number of filters given to setFilters() once optimized
+	 */
+	size_t getNumberOfKernelFilters() const { return mKernelFilters; }
+
+	/*
+	 * Reduces the filters to an equivalent set, as the kernel checks them
+	 * one by one for every frame. Filters subsumed by others are removed
+	 * and filters with the same mask whose ids differ in a single bit are
+	 * merged, until no more reductions are possible. Inverted filters are
+	 * left untouched. Returns the number of remaining filters.
+	 */
+	static size_t optimizeFilters(std::vector<can_filter> &filters);
+
+	// Filtering is already done in kernel space, unless the statistics
+	// socket could not be opened and the bus statistics need all the frames
+	bool isKernelFiltering() const override { return mKernelFilters > 0; }
+
+	/*
+	 * Opens the statistics socket. If it cannot be opened, the statistics
+	 * are fed with the frames received, and setFilters() keeps all of them
+	 * in the reception socket to filter them in user space.
+	 */
+	void setBusStatistics(
+		const std::shared_ptr<BusStatistics> &statistics) override;
+
+	int getStatisticsFD() override { return mStatsSock; }
+	void drainStatistics() override;
+
+	// Through the loopback of the interface, only in the statistics socket
+	bool receivesOwnFrames() const override { return mStatsSock != -1; }
 
 	bool receive(CanFrame &, Utils::TimeStamp &) override;
 
+	size_t receiveBatch(CanFrame *frames, Utils::TimeStamp *tStamps,
+						size_t max) override;
+
 	int getFD() override;
 };
 
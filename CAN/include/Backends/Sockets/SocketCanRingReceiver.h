@@ -0,0 +1,73 @@
+/*
+ * SocketCanRingReceiver.h
+ *
+ *  Receiver based on a PF_PACKET socket with a memory mapped reception ring
+ *  (TPACKET_V3). The kernel fills blocks of frames in the ring and the
+ *  frames are taken directly from there, without a syscall per frame.
+ */
+
+#ifndef BACKENDS_SOCKETS_SOCKETCANRINGRECEIVER_H_
+#define BACKENDS_SOCKETS_SOCKETCANRINGRECEIVER_H_
+
+#include <string>
+
+#include <CommonCanReceiver.h>
+
+// Geometry of the reception ring
+#define SOCKETCAN_RING_BLOCK_SIZE (1 << 16)
+#define SOCKETCAN_RING_BLOCK_NR 64
+#define SOCKETCAN_RING_FRAME_SIZE 128
+
+// Milliseconds after which the kernel hands a block that is not full
+#define SOCKETCAN_RING_RETIRE_TIMEOUT 10
+
+struct tpacket3_hdr;
+
+namespace Can
+{
+namespace Sockets
+{
+class SocketCanRingReceiver : public CommonCanReceiver
+{
+  private:
+	int mSock = -1;
+	u8 *mRing = nullptr;
+	size_t mRingSize = 0;
+
+	// Position in the ring
+	size_t mCurrentBlock = 0;
+	tpacket3_hdr *mPacket = nullptr; // Next packet of the current block
+	u32 mRemaining = 0;				 // Packets left in the current block
+
+	void releaseBlock();
+
+  public:
+	SocketCanRingReceiver() {}
+	virtual ~SocketCanRingReceiver();
+
+	SocketCanRingReceiver(const SocketCanRingReceiver &other) = delete;
+	SocketCanRingReceiver &
+	operator=(const SocketCanRingReceiver &other) = delete;
+
+	/*
+	 * Opens the packet socket for the given interface and maps the ring.
+	 * Needs the CAP_NET_RAW capability.
+	 */
+	bool open(const std::string &interface);
+	void close();
+
+	int getFD() override { return mSock; }
+
+	bool receive(CanFrame &, Utils::TimeStamp &) override;
+
+	/*
+	 * Does not block, returns 0 if the kernel has not handed any block.
+	 */
+	size_t receiveBatch(CanFrame *frames, Utils::TimeStamp *tStamps,
+						size_t max) override;
+};
+
+} /* namespace Sockets */
+} /* namespace Can */
+
+#endif /* BACKENDS_SOCKETS_SOCKETCANRINGRECEIVER_H_ */
@@ -9,26 +9,92 @@
 #ifndef BACKENDS_SOCKETS_SOCKETCANSENDER_H_
 #define BACKENDS_SOCKETS_SOCKETCANSENDER_H_
 
+#include <memory>
+
 #include "../../CommonCanSender.h"
 
+// Maximum number of frames given to the kernel by a single sendmmsg call
+#define SOCKETCAN_SEND_BATCH_SIZE 64
+
+// Frames waiting for room in the socket before applying the TX policy
+#define SOCKETCAN_TX_QUEUE_SIZE 256
+
+// Millis to wait before retrying when the queue of the interface is full
+// (ENOBUFS), as the socket is still reported as writable (POLLOUT)
+#define SOCKETCAN_TX_RETRY_TIMEOUT 1
+
+// Millis to wait for room in the socket buffer (POLLOUT) before checking if
+// the sender is being destroyed
+#define SOCKETCAN_TX_POLL_TIMEOUT 100
+
+// Priority classes of the queued frames, given by the 3 most significant
+// bits of the identifier (the priority field in J1939)
+#define SOCKETCAN_TX_PRIORITIES 8
+
 namespace Can
 {
 namespace Sockets
 {
 class SocketCanSender : public CommonCanSender
 {
+  public:
+	/*
+	 * What to do with a frame when the TX queue is full. Regardless of the
+	 * policy, a frame always takes the place of a frame with lower priority.
+	 */
+	enum TxPolicy {
+		DROP_OLDEST, // Drop the oldest frame with the same priority
+		DROP_NEWEST, // Drop the frame being sent
+		BLOCK,		 // Wait until there is room in the queue
+	};
+
+	struct TxStats {
+		size_t depth;  // Frames currently queued
+		u64 sent;	  // Frames written to the socket
+		u64 dropped;   // Frames dropped because the queue was full
+		u64 retries;   // Times the socket had no room for the queued frames
+	};
+
   private:
 	/*
 	 * An already initialized socket where to send the frames
 	 */
 	int mSock;
 
+	// Frames that could not be written because the socket was full, retried
+	// from a dedicated thread
+	struct TxQueue;
+	std::unique_ptr<TxQueue> mTxQueue;
+
+	size_t sendRaw(const CanFrame *frames, size_t count, int &error) const;
+
+	/*
+	 * Returns false if the frame is dropped instead of being queued
+	 */
+	bool enqueue(std::unique_lock<std::mutex> &lock,
+				 const CanFrame &frame) const;
+	void notifyErrors(std::unique_lock<std::mutex> &lock) const;
+	void runTxQueue();
+
+	static u8 getPriority(const CanFrame &frame);
+
   protected:
 	void _sendFrame(const CanFrame &frame) const override;
 
+	/*
+	 * The frames not fitting in the socket are queued. Returns the number of
+	 * frames written or queued, without the ones which failed or were
+	 * dropped by the TX policy.
+	 */
+	size_t _sendFrames(const CanFrame *frames, size_t count) const override;
+
   public:
 	SocketCanSender(int sock);
 	virtual ~SocketCanSender();
+
+	void setTxPolicy(TxPolicy policy);
+	void setTxQueueSize(size_t size);
+	TxStats getTxStats() const;
 };
 
 } /* namespace Sockets */
@@ -0,0 +1,69 @@
+/*
+ * VirtualCanBus.h
+ *
+ *  In-memory CAN bus shared by the virtual senders and receivers of an
+ *  interface, without going through the kernel.
+ */
+
+#ifndef BACKENDS_VIRTUAL_VIRTUALCANBUS_H_
+#define BACKENDS_VIRTUAL_VIRTUALCANBUS_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <Utils.h>
+
+#include <CanFrame.h>
+
+namespace Can
+{
+namespace Virtual
+{
+class VirtualCanReceiver;
+
+class VirtualCanBus
+{
+  private:
+	static std::mutex mBusesLock;
+	static std::map<std::string, std::shared_ptr<VirtualCanBus>> mBuses;
+
+	std::mutex mLock;
+	std::vector<VirtualCanReceiver *> mReceivers;
+	u32 mBitrate = 0;
+	bool mPacing = false;
+	Utils::TimeStamp mIdleTime; // When the bus finishes the current frame
+
+	void deliver(const CanFrame *frames, size_t count,
+				 const Utils::TimeStamp &tStamp);
+
+  public:
+	/*
+	 * Returns the bus with the given name, which is created the first time
+	 */
+	static std::shared_ptr<VirtualCanBus> getBus(const std::string &name);
+
+	void attach(VirtualCanReceiver *receiver);
+	void detach(VirtualCanReceiver *receiver);
+
+	void setBitrate(u32 bitrate) { mBitrate = bitrate; }
+
+	/*
+	 * If enabled, transmit() takes as long as the frames would take on a real
+	 * bus with the configured bitrate
+	 */
+	void setPacing(bool pacing) { mPacing = pacing; }
+
+	/*
+	 * Delivers the frames to all the receivers attached to the bus. Returns
+	 * the number of frames transmitted.
+	 */
+	size_t transmit(const CanFrame *frames, size_t count);
+};
+
+} /* namespace Virtual */
+} /* namespace Can */
+
+#endif /* BACKENDS_VIRTUAL_VIRTUALCANBUS_H_ */
@@ -0,0 +1,69 @@
+/*
+ * VirtualCanHelper.h
+ *
+ *  Backend with in-memory CAN buses, useful to test and benchmark the
+ *  library without CAN hardware nor vcan interfaces.
+ */
+
+#ifndef VIRTUALCANHELPER_H_
+#define VIRTUALCANHELPER_H_
+
+#include <memory>
+#include <set>
+#include <string>
+
+#include <ICanHelper.h>
+
+#include <Backends/Virtual/VirtualCanBus.h>
+
+#define VIRTUALCAN_IFACE_PREFIX "vbus"
+
+namespace Can
+{
+namespace Virtual
+{
+class VirtualCanHelper : public Can::ICanHelper
+{
+  private:
+	static size_t mNumberOfIfaces;
+	static bool mPacing;
+
+	std::shared_ptr<VirtualCanBus> mBus;
+
+  public:
+	VirtualCanHelper() {}
+	virtual ~VirtualCanHelper() {}
+
+	/*
+	 * Returns the names of the virtual interfaces (vbus0, vbus1...)
+	 */
+	static std::set<std::string> getCanIfaces();
+
+	/*
+	 * Number of virtual interfaces offered by the backend, none by default.
+	 * If pacing is set, the frames take as long as on a real bus with the
+	 * bitrate given at initialization. Must be called before creating the
+	 * helpers.
+	 */
+	static void setNumberOfInterfaces(size_t count, bool pacing = false)
+	{
+		mNumberOfIfaces = count;
+		mPacing = pacing;
+	}
+
+	std::string getBackend() override { return "Virtual"; }
+
+	ICanSender *allocateCanSender() override;
+	CommonCanReceiver *allocateCanReceiver() override;
+
+	bool initialize(std::string interface, u32 bitrate) override;
+
+	void finalize() override;
+
+	bool initialized() override { return mBus != nullptr; }
+};
+
+} // namespace Virtual
+} // namespace Can
+
+#endif /* VIRTUALCANHELPER_H_ */
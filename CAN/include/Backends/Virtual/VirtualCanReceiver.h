@@ -0,0 +1,61 @@
+/*
+ * VirtualCanReceiver.h
+ *
+ *  Receiver attached to a virtual bus. The frames are queued in memory and
+ *  an eventfd signals when there are frames pending, so that it can be
+ *  watched by CanSniffer as any other receiver.
+ */
+
+#ifndef BACKENDS_VIRTUAL_VIRTUALCANRECEIVER_H_
+#define BACKENDS_VIRTUAL_VIRTUALCANRECEIVER_H_
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <CommonCanReceiver.h>
+
+#include <Backends/Virtual/VirtualCanBus.h>
+
+// Frames queued before dropping, like the socket buffer of a real interface
+#define VIRTUALCAN_RX_QUEUE_SIZE 65536
+
+namespace Can
+{
+namespace Virtual
+{
+class VirtualCanReceiver : public CommonCanReceiver
+{
+  private:
+	std::shared_ptr<VirtualCanBus> mBus;
+	int mEventFd;
+
+	std::mutex mLock;
+	std::deque<std::pair<CanFrame, Utils::TimeStamp>> mQueue;
+
+  public:
+	VirtualCanReceiver(std::shared_ptr<VirtualCanBus> bus);
+	virtual ~VirtualCanReceiver();
+
+	/*
+	 * Called by the bus to queue the transmitted frames
+	 */
+	void deliver(const CanFrame *frames, size_t count,
+				 const Utils::TimeStamp &tStamp);
+
+	int getFD() override { return mEventFd; }
+
+	// The bus delivers the frames to all the receivers, the sender's too
+	bool receivesOwnFrames() const override { return true; }
+
+	bool receive(CanFrame &, Utils::TimeStamp &) override;
+
+	size_t receiveBatch(CanFrame *frames, Utils::TimeStamp *tStamps,
+						size_t max) override;
+};
+
+} /* namespace Virtual */
+} /* namespace Can */
+
+#endif /* BACKENDS_VIRTUAL_VIRTUALCANRECEIVER_H_ */
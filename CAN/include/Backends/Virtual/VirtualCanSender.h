@@ -0,0 +1,37 @@
+/*
+ * VirtualCanSender.h
+ *
+ *  Implementation of can sender for the virtual buses
+ */
+
+#ifndef BACKENDS_VIRTUAL_VIRTUALCANSENDER_H_
+#define BACKENDS_VIRTUAL_VIRTUALCANSENDER_H_
+
+#include <memory>
+
+#include <CommonCanSender.h>
+
+#include <Backends/Virtual/VirtualCanBus.h>
+
+namespace Can
+{
+namespace Virtual
+{
+class VirtualCanSender : public CommonCanSender
+{
+  private:
+	std::shared_ptr<VirtualCanBus> mBus;
+
+  protected:
+	void _sendFrame(const CanFrame &frame) const override;
+	size_t _sendFrames(const CanFrame *frames, size_t count) const override;
+
+  public:
+	VirtualCanSender(std::shared_ptr<VirtualCanBus> bus);
+	virtual ~VirtualCanSender();
+};
+
+} /* namespace Virtual */
+} /* namespace Can */
+
+#endif /* BACKENDS_VIRTUAL_VIRTUALCANSENDER_H_ */
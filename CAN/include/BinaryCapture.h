@@ -0,0 +1,127 @@
+/*
+ * BinaryCapture.h
+ *
+ *  Layout of the binary capture files, a compact alternative to the TRC
+ *  files (about 16 bytes per classic frame instead of 60). The fields are
+ *  in host byte order:
+ *
+ *  magic | block | block | ... | index | interfaces | footer
+ *
+ *  Every block is a BinaryCaptureBlock followed by the records of its
+ *  frames, each one made of:
+ *    - The difference in nanoseconds with the time of the previous frame of
+ *      the block (the first time of the block for the first one), as a
+ *      zigzag varint
+ *    - The identifier in the 29 low bits and the interface in the 3 high
+ *      ones (4 bytes)
+ *    - The BIN_CAPTURE_FLAG_* in the low nibble and the DLC in the high one
+ *      (1 byte)
+ *    - The payload, as many bytes as given by the DLC
+ *
+ *  The index holds an entry per block. The interfaces are a count followed
+ *  by the names, prefixed by their length (1 byte). The footer locates the
+ *  index, and if it is missing (e.g. the recording was interrupted), the
+ *  complete blocks are taken walking from the beginning of the file.
+ */
+
+#ifndef BINARYCAPTURE_H_
+#define BINARYCAPTURE_H_
+
+#include <Types.h>
+
+#include <CanFrame.h>
+
+// Beginning of the files and end of the footer, with the version of the
+// layout
+#define BIN_CAPTURE_MAGIC "CANCAP01"
+#define BIN_CAPTURE_FOOTER_MAGIC "CANIDX01"
+#define BIN_CAPTURE_MAGIC_SIZE 8
+
+// Beginning of every block ("CBLK")
+#define BIN_CAPTURE_BLOCK_MAGIC 0x4B4C4243
+
+// Usual extension of the files
+#define BIN_CAPTURE_EXTENSION ".bcap"
+
+// Bytes of records after which a block is written
+#define BIN_CAPTURE_BLOCK_SIZE (64 * 1024)
+
+#define BIN_CAPTURE_FLAG_EXTENDED 0x01
+#define BIN_CAPTURE_FLAG_FD 0x02
+#define BIN_CAPTURE_FLAG_BRS 0x04
+#define BIN_CAPTURE_FLAG_ESI 0x08
+
+#define BIN_CAPTURE_ID_MASK 0x1FFFFFFF
+#define BIN_CAPTURE_INTERFACE_SHIFT 29
+#define BIN_CAPTURE_MAX_INTERFACES 8
+
+#define BIN_CAPTURE_MAX_VARINT_SIZE 10
+#define BIN_CAPTURE_MAX_RECORD_SIZE                                            \
+	(BIN_CAPTURE_MAX_VARINT_SIZE + 4 + 1 + MAX_CANFD_DATA_SIZE)
+
+namespace Can
+{
+struct BinaryCaptureBlock {
+	u32 magic;
+	u32 size; // Bytes of the records
+	u32 frames;
+	u32 interfaces; // Mask of the interfaces of the frames
+	u64 position;	// Of the first frame
+	s64 firstTime;	// Nanoseconds
+	s64 lastTime;
+};
+
+struct BinaryCaptureIndexEntry {
+	u64 offset; // Of the block
+	BinaryCaptureBlock block;
+};
+
+struct BinaryCaptureFooter {
+	u64 indexOffset;
+	u64 blocks;
+	u64 frames;
+	char magic[BIN_CAPTURE_MAGIC_SIZE];
+};
+
+namespace BinaryCapture
+{
+/*
+ * Returns the bytes written, BIN_CAPTURE_MAX_VARINT_SIZE at most
+ */
+inline size_t writeVarint(u8 *pos, s64 value)
+{
+	u64 zigzag = ((u64)value << 1) ^ (u64)(value >> 63);
+	size_t size = 0;
+
+	while (zigzag >= 0x80) {
+		pos[size++] = (u8)(zigzag | 0x80);
+		zigzag >>= 7;
+	}
+
+	pos[size++] = (u8)zigzag;
+
+	return size;
+}
+
+inline bool readVarint(const u8 *&pos, const u8 *end, s64 &value)
+{
+	u64 zigzag = 0;
+
+	for (u32 shift = 0; pos < end && shift < 64; shift += 7) {
+		u8 byte = *pos++;
+
+		zigzag |= (u64)(byte & 0x7F) << shift;
+
+		if (!(byte & 0x80)) {
+			value = (s64)(zigzag >> 1) ^ -(s64)(zigzag & 1);
+			return true;
+		}
+	}
+
+	return false;
+}
+} // namespace BinaryCapture
+
+} /* namespace Can */
+
+#endif /* BINARYCAPTURE_H_ */
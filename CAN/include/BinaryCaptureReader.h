@@ -0,0 +1,131 @@
+/*
+ * BinaryCaptureReader.h
+ *
+ *  Reads the files written by BinaryCaptureWriter, with the same interface
+ *  as TRCReader. The file is mapped in memory and the records are decoded
+ *  straight from it.
+ */
+
+#ifndef BINARYCAPTUREREADER_H_
+#define BINARYCAPTUREREADER_H_
+
+#include <exception>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <BinaryCapture.h>
+#include <MappedFile.h>
+
+#include "CanFrame.h"
+#include "Utils.h"
+
+namespace Can
+{
+class BinaryCaptureReadException : public std::exception
+{
+  public:
+	const char *what() const noexcept override
+	{
+		return "Malformed binary capture record";
+	}
+};
+
+class BinaryCaptureReader
+{
+  private:
+	std::string mFileName;
+	MappedFile mFile;
+
+	std::vector<BinaryCaptureIndexEntry> mIndex;
+	std::vector<std::string> mInterfaces;
+	size_t mTotalFrames;
+
+	// Next record to read
+	size_t mBlock;
+	const u8 *mRecord;
+	const u8 *mRecordsEnd;
+	u32 mRemainingFrames; // In the block
+	s64 mTime;			  // Of the previous frame of the block
+	size_t mNextPos;
+
+	size_t mCurrentPos;
+	std::pair<Utils::TimeStamp, CanFrame> mLastReadFrameTimePair;
+	u8 mLastInterface;
+
+	/*
+	 * Takes the index and the interfaces from the end of the file
+	 */
+	bool loadIndex();
+
+	/*
+	 * Takes the complete blocks from the beginning of the file
+	 */
+	void findBlocks();
+
+	void enterBlock(size_t block);
+	bool readRecord();
+
+	/*
+	 * Reads the frames until the predicate, given the position and time stamp
+	 * of every frame read, returns true
+	 */
+	template <typename Predicate> bool readUntil(Predicate predicate);
+
+  public:
+	BinaryCaptureReader();
+	BinaryCaptureReader(const std::string &path);
+	virtual ~BinaryCaptureReader();
+
+	/*
+	 * Only the layout of the blocks is checked, the malformed records are
+	 * found when read
+	 */
+	bool loadFile(const std::string &path);
+	void unloadFile();
+	bool isFileLoaded() const { return !mFileName.empty(); }
+
+	size_t getNumberOfFrames() const { return mTotalFrames; }
+	size_t getNumberOfBlocks() const { return mIndex.size(); }
+
+	size_t getCurrentPos() const { return mCurrentPos; }
+
+	/*
+	 * True when there is nothing else to read
+	 */
+	bool isEndOfFile() const { return mNextPos >= mTotalFrames; }
+
+	/*
+	 * The frame at the given position becomes the last read frame
+	 */
+	bool seekPosition(size_t pos);
+
+	/*
+	 * Same for the first frame whose time stamp is not earlier than the
+	 * given one. The time stamps are supposed to be in order.
+	 */
+	bool seekTime(const Utils::TimeStamp &tStamp);
+
+	std::pair<Utils::TimeStamp, CanFrame> getLastCanFrame();
+
+	/*
+	 * Interface of the last read frame and its name, empty if it was not
+	 * given or the file was not closed
+	 */
+	u8 getLastInterface() const { return mLastInterface; }
+	std::string getInterfaceName(u8 interface) const;
+
+	/*
+	 * Throws BinaryCaptureReadException if the next record is malformed
+	 */
+	void readNextCanFrame();
+
+	/*
+	 * Resets the reader to the beginning
+	 */
+	void reset();
+};
+
+} /* namespace Can */
+
+#endif /* BINARYCAPTUREREADER_H_ */
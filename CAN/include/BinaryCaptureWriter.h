@@ -0,0 +1,79 @@
+/*
+ * BinaryCaptureWriter.h
+ *
+ *  Writes the frames in the binary capture format (see BinaryCapture.h).
+ */
+
+#ifndef BINARYCAPTUREWRITER_H_
+#define BINARYCAPTUREWRITER_H_
+
+#include <stdio.h>
+
+#include <exception>
+#include <string>
+#include <vector>
+
+#include <BinaryCapture.h>
+
+#include "CanFrame.h"
+#include "Utils.h"
+
+namespace Can
+{
+class BinaryCaptureWriter
+{
+  private:
+	FILE *mFile;
+	u64 mOffset; // Of the next block
+
+	// Block being filled
+	BinaryCaptureBlock mBlock;
+	std::vector<u8> mRecords;
+	s64 mLastTime;
+
+	std::vector<BinaryCaptureIndexEntry> mIndex;
+	std::vector<std::string> mInterfaces;
+	u64 mFrames;
+
+  public:
+	BinaryCaptureWriter();
+	BinaryCaptureWriter(const std::string &file);
+	virtual ~BinaryCaptureWriter();
+
+	BinaryCaptureWriter(const BinaryCaptureWriter &other) = delete;
+	BinaryCaptureWriter &operator=(const BinaryCaptureWriter &other) = delete;
+
+	/*
+	 * The payload of CAN FD frames whose length is not one of a DLC is padded
+	 * with zeros. Throws BinaryCaptureWriteException if the file is not open,
+	 * the interface is not valid or the block could not be written.
+	 */
+	void write(const CanFrame &frame, const Utils::TimeStamp &timeStamp,
+			   u8 interface = 0);
+
+	/*
+	 * Name of the interface, saved along with the index
+	 */
+	bool setInterface(u8 interface, const std::string &name);
+
+	/*
+	 * Writes the block being filled, so that only the frames written after it
+	 * are lost if the program does not close the file
+	 */
+	bool flush();
+
+	bool open(const std::string &file);
+
+	/*
+	 * Writes the last block and the index
+	 */
+	void close();
+
+	class BinaryCaptureWriteException : public std::exception
+	{
+	};
+};
+
+} /* namespace Can */
+
+#endif /* BINARYCAPTUREWRITER_H_ */
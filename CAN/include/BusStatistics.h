@@ -0,0 +1,79 @@
+/*
+ * BusStatistics.h
+ *
+ *  Frame rate and bus load of a CAN interface, fed with the frames received
+ *  and sent through it.
+ */
+
+#ifndef BUSSTATISTICS_H_
+#define BUSSTATISTICS_H_
+
+#include <mutex>
+
+#include <Utils.h>
+
+#include <CanFrame.h>
+
+// Millis of the windows in which the frames are accounted
+#define BUS_STATS_WINDOW 100
+
+// Number of windows over which the rates are given (one second)
+#define BUS_STATS_WINDOWS 10
+
+namespace Can
+{
+class BusStatistics
+{
+  public:
+	struct Snapshot {
+		double framesPerSecond; // Over the last second
+		double bitsPerSecond;
+		double load;			// Percentage of the bitrate
+		double peakLoad;		// Highest load in a window of 100 ms
+		u64 frames;				// Since the creation or the last reset
+		u64 bits;
+	};
+
+  private:
+	struct Window {
+		s64 index; // Time from the epoch, in windows
+		u64 frames;
+		u64 bits;
+	};
+
+	u32 mBitrate;
+
+	mutable std::mutex mLock;
+	Window mWindows[BUS_STATS_WINDOWS];
+	u64 mPeakBits;
+	u64 mFrames;
+	u64 mBits;
+
+  public:
+	BusStatistics(u32 bitrate);
+
+	u32 getBitrate() const { return mBitrate; }
+
+	/*
+	 * Accounts the given frames, sent or received at the given time
+	 */
+	void addFrames(const CanFrame *frames, size_t count,
+				   const Utils::TimeStamp &now = Utils::TimeStamp::now());
+
+	Snapshot getSnapshot(
+		const Utils::TimeStamp &now = Utils::TimeStamp::now()) const;
+
+	void reset();
+
+	/*
+	 * Number of bits the frame takes on the bus, from the start of frame to
+	 * the end of the interframe space, including the stuff bits. For CAN FD
+	 * frames the data phase is counted as if it was sent at the nominal
+	 * bitrate.
+	 */
+	static u32 getFrameBits(const CanFrame &frame);
+};
+
+} /* namespace Can */
+
+#endif /* BUSSTATISTICS_H_ */
@@ -28,6 +28,9 @@ class CanEasy
 
 	static std::set<std::string> mInitializedIfaces;
 
+	// Frame rate and bus load of every interface
+	static std::map<std::string, std::shared_ptr<BusStatistics>> mStatistics;
+
   public:
 	/*
 	 * To initialize for sending and receiving
@@ -48,6 +51,13 @@ class CanEasy
 
 	static std::shared_ptr<ICanSender> getSender(const std::string &interface);
 
+	/*
+	 * Fed with the frames received by the sniffer, while sniffing, and with
+	 * the frames sent that the sniffer does not get
+	 */
+	static std::shared_ptr<BusStatistics>
+	getBusStatistics(const std::string &interface);
+
 	static CanSniffer &getSniffer() { return mSniffer; }
 
 	static void finalize();
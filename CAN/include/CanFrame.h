@@ -9,36 +9,91 @@
 #define CANFRAME_H_
 
 #include <Types.h>
+#include <string.h>
 #include <string>
 
 #define MAX_CAN_DATA_SIZE 8
+#define MAX_CANFD_DATA_SIZE 64
 
 namespace Can
 {
+/*
+ * The payload is stored inline, so that frames can be copied without any
+ * allocation (the class is trivially copyable).
+ */
 class CanFrame
 {
   private:
 	bool mExtendedFormat;
+	bool mFdFormat;
+	bool mBitrateSwitch;
+	bool mErrorStateIndicator;
 	u32 mId;
-	std::string mData;
+	u8 mLength;
+	u8 mData[MAX_CANFD_DATA_SIZE];
 
   public:
 	CanFrame();
-	CanFrame(bool extFormat, u32 id) : mExtendedFormat(extFormat), mId(id) {}
+	CanFrame(bool extFormat, u32 id)
+		: mExtendedFormat(extFormat), mFdFormat(false),
+		  mBitrateSwitch(false), mErrorStateIndicator(false), mId(id),
+		  mLength(0)
+	{
+	}
 	CanFrame(bool extFormat, u32 id, const std::string &data)
-		: mExtendedFormat(extFormat), mId(id)
+		: mExtendedFormat(extFormat), mFdFormat(false),
+		  mBitrateSwitch(false), mErrorStateIndicator(false), mId(id),
+		  mLength(0)
 	{
 		setData(data);
 	}
-	virtual ~CanFrame();
+	CanFrame(bool extFormat, u32 id, const u8 *data, size_t length)
+		: mExtendedFormat(extFormat), mFdFormat(false),
+		  mBitrateSwitch(false), mErrorStateIndicator(false), mId(id),
+		  mLength(0)
+	{
+		setData(data, length);
+	}
+
+	/*
+	 * Returns a copy of the payload. Prefer getRawData() and getDataLength()
+	 * in hot paths.
+	 */
+	std::string getData() const
+	{
+		return std::string(reinterpret_cast<const char *>(mData), mLength);
+	}
+
+	const u8 *getRawData() const { return mData; }
+
+	/*
+	 * To fill the payload in place, without copies: up to getMaxDataLength()
+	 * bytes can be written, then the length is set with setDataLength().
+	 */
+	u8 *getRawData() { return mData; }
+
+	size_t getDataLength() const { return mLength; }
 
-	const std::string &getData() const { return mData; }
+	bool setDataLength(size_t length)
+	{
+		if (length > getMaxDataLength())
+			return false;
+		mLength = length;
+		return true;
+	}
 
 	bool setData(const std::string &data)
 	{
-		if (data.size() > MAX_CAN_DATA_SIZE)
+		return setData(reinterpret_cast<const u8 *>(data.c_str()),
+					   data.size());
+	}
+
+	bool setData(const u8 *data, size_t length)
+	{
+		if (length > getMaxDataLength())
 			return false;
-		mData = data;
+		memcpy(mData, data, length);
+		mLength = length;
 		return true;
 	}
 
@@ -49,7 +104,7 @@ class CanFrame
 	void clear()
 	{
 		mId = 0;
-		mData.clear();
+		mLength = 0;
 	}
 
 	bool isExtendedFormat() const { return mExtendedFormat; }
@@ -59,6 +114,38 @@ class CanFrame
 		mExtendedFormat = extendedFormat;
 	}
 
+	/*
+	 * CAN FD frames carry up to 64 bytes. Clearing the flag truncates the
+	 * payload to the size of a classic frame.
+	 */
+	bool isFdFormat() const { return mFdFormat; }
+
+	void setFdFormat(bool fdFormat)
+	{
+		mFdFormat = fdFormat;
+		if (!mFdFormat && mLength > MAX_CAN_DATA_SIZE)
+			mLength = MAX_CAN_DATA_SIZE;
+	}
+
+	bool isBitrateSwitch() const { return mBitrateSwitch; }
+
+	void setBitrateSwitch(bool brs) { mBitrateSwitch = brs; }
+
+	bool isErrorStateIndicator() const { return mErrorStateIndicator; }
+
+	void setErrorStateIndicator(bool esi) { mErrorStateIndicator = esi; }
+
+	size_t getMaxDataLength() const
+	{
+		return mFdFormat ? MAX_CANFD_DATA_SIZE : MAX_CAN_DATA_SIZE;
+	}
+
+	/*
+	 * Conversions between the data length code and the number of bytes
+	 */
+	static u8 lengthToDlc(size_t length);
+	static size_t dlcToLength(u8 dlc);
+
 	// To show human readable data
 	std::string hexDump() const;
 };
@@ -8,30 +8,117 @@
 #ifndef CANSNIFFER_H_
 #define CANSNIFFER_H_
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#include <SPSCRing.h>
+
 #include "CommonCanReceiver.h"
 
 typedef void (*OnReceiveFramePtr)(const Can::CanFrame &frame,
 								  const Utils::TimeStamp &tStamp,
 								  const std::string &interface, void *data);
+typedef void (*OnReceiveFramesPtr)(const Can::CanFrame *frames,
+								   const Utils::TimeStamp *tStamps,
+								   size_t count, const std::string &interface,
+								   void *data);
 typedef bool (*OnTimeoutPtr)();
+typedef void (*OnFdReadyPtr)(int fd, void *data);
+typedef void (*OnDropPtr)(u64 dropped, u64 total, const std::string &interface,
+						  void *data);
+
+// Maximum number of frames drained from a receiver per wakeup
+#define CAN_SNIFFER_BATCH_SIZE 64
+
+// Default number of frames buffered per receiver in pipelined mode
+#define CAN_SNIFFER_PIPELINE_CAPACITY 4096
 
 namespace Can
 {
 class CanSniffer
 {
+  public:
+	/*
+	 * What the receive thread of the pipelined mode does with a frame when
+	 * the ring of its receiver is full
+	 */
+	enum DropPolicy {
+		DROP_NEWEST, // The frame is discarded and counted as an overflow
+		WAIT, // Stop reading from the receiver until the consumer makes room
+	};
+
+	struct PipelineStats {
+		size_t capacity;
+		size_t occupancy;
+		size_t highWaterMark; // Maximum occupancy of the ring
+		u64 overflows;		  // Frames discarded because the ring was full
+	};
+
   private:
+	struct RxSlot {
+		CanFrame frame;
+		Utils::TimeStamp tStamp;
+	};
+
+	// Frames of a receiver on their way from its receive thread to the
+	// consumer
+	struct Pipeline {
+		Utils::SPSCRing<RxSlot> ring;
+		std::atomic<u64> overflows;
+		std::thread thread;
+
+		Pipeline(size_t capacity) : ring(capacity), overflows(0) {}
+	};
+
 	OnReceiveFramePtr mRcvCB = nullptr;
+	OnReceiveFramesPtr mRcvBatchCB = nullptr;
 	OnTimeoutPtr mTimeoutCB = nullptr;
+	OnDropPtr mDropCB = nullptr;
 	void *mData = nullptr; // Data to be passed to the OnReceiveFramePtr
 						   // callback
 	std::vector<CommonCanReceiver *> mReceivers;
-	bool mRunning = true;
+	std::atomic<bool> mRunning{true};
+
+	// Additional file descriptors watched in the same loop as the receivers
+	struct UserFd {
+		int fd;
+		OnFdReadyPtr callback;
+		void *data;
+	};
+	std::vector<UserFd> mUserFds;
+
+	// Dropped frames of every receiver already given to the drop callback
+	mutable std::vector<u64> mReportedDrops;
+
+	// Buffers where the frames of a receiver are drained on every wakeup
+	mutable std::vector<CanFrame> mFrames =
+		std::vector<CanFrame>(CAN_SNIFFER_BATCH_SIZE);
+	mutable std::vector<Utils::TimeStamp> mTimeStamps =
+		std::vector<Utils::TimeStamp>(CAN_SNIFFER_BATCH_SIZE);
+
+	std::vector<std::unique_ptr<Pipeline>> mPipelines;
+	mutable std::mutex mPipelinesLock; // Rebuilt when sniffing starts
+	size_t mPipelineCapacity = CAN_SNIFFER_PIPELINE_CAPACITY;
+	DropPolicy mDropPolicy = DROP_NEWEST;
+	int mPipelineEventFd = -1; // Wakes up the consumer
 
 	int wait_fd(timeval tv, fd_set &) const;
 	void notify(fd_set &) const;
-	void notify_recv(CommonCanReceiver *recv) const;
+	size_t notify_recv(size_t index) const;
+	void checkDrops(size_t index) const;
+	void dispatch(const std::string &interface, size_t count) const;
+	void pipelineReceive(size_t index, u32 timeout);
+
+	/*
+	 * Watches the statistics descriptor of the receiver, if any, once
+	 */
+	void watchStatistics(CommonCanReceiver *receiver);
+
+	static size_t filterFrames(CommonCanReceiver *recv, CanFrame *frames,
+							   Utils::TimeStamp *tStamps, size_t count);
   public:
 	CanSniffer() {}
 	CanSniffer(OnReceiveFramePtr recvCB, OnTimeoutPtr timeoutCB,
@@ -47,17 +134,81 @@ class CanSniffer
 	 * Add a receiver from where to receive the frames. CanSniffer becomes the
 	 * owner and will deallocate the receiver.
 	 */
-	void addReceiver(CommonCanReceiver *receiver)
+	void addReceiver(CommonCanReceiver *receiver);
+
+	/*
+	 * Calls the callbacks as the frames are received, until finish() is
+	 * called. If the receivers have a CPU assigned, the calling thread is
+	 * pinned to their CPUs, also in sniffEpoll(). In the pipelined mode every
+	 * receive thread is pinned to the CPU of its receiver instead.
+	 */
+	void sniff(u32 timeout) const;
+
+	/*
+	 * Same as sniff() but based on epoll. The file descriptors are registered
+	 * once, the receivers are edge triggered and drained until no frames are
+	 * pending, so their receiveBatch() must not block when the queue is empty.
+	 */
+	void sniffEpoll(u32 timeout) const;
+
+	/*
+	 * Pipelined mode: a thread per receiver does nothing but draining it and
+	 * queueing the frames in a lock-free ring, while the callbacks are called
+	 * from the thread calling this method. This way a slow callback does not
+	 * make the socket buffers overflow. Returns after finish() is called,
+	 * once the receive threads have been joined.
+	 */
+	void sniffPipelined(u32 timeout);
+
+	/*
+	 * Configuration of the pipelined mode, to be set before sniffing
+	 */
+	void setPipelineCapacity(size_t capacity) { mPipelineCapacity = capacity; }
+	void setDropPolicy(DropPolicy policy) { mDropPolicy = policy; }
+
+	/*
+	 * Statistics of the ring of the given receiver in the pipelined mode.
+	 * Can be called from any thread, also while sniffPipelined() starts or
+	 * after it has finished.
+	 */
+	PipelineStats getPipelineStats(size_t receiver) const;
+
+	/*
+	 * Watches an additional file descriptor (timers, eventfds...) in the
+	 * sniffing loop. The callback is called while the fd is readable, the
+	 * user is in charge of reading from it.
+	 */
+	void addUserFd(int fd, OnFdReadyPtr callback, void *data = nullptr)
 	{
-		mReceivers.push_back(receiver);
+		mUserFds.push_back({fd, callback, data});
 	}
-	void sniff(u32 timeout) const;
+
+	/*
+	 * Sets the filters of every receiver. The descriptors feeding the bus
+	 * statistics of the receivers filtering in kernel space are watched from
+	 * then on.
+	 */
 	void setFilters(std::set<CanFilter> filters);
 	int getNumberOfReceivers() const { return mReceivers.size(); }
 	void reset() { mRunning = true; }
 	void finish() { mRunning = false; }
 	void setOnRecv(OnReceiveFramePtr recvCB) { mRcvCB = recvCB; }
+
+	/*
+	 * Batched mode: instead of being called once per frame, the callback
+	 * receives all the frames drained from a receiver in a single wakeup.
+	 * Takes precedence over the callback given by setOnRecv().
+	 */
+	void setOnRecvBatch(OnReceiveFramesPtr recvCB) { mRcvBatchCB = recvCB; }
 	void setOnTimeout(OnTimeoutPtr timeoutCB) { mTimeoutCB = timeoutCB; }
+
+	/*
+	 * Called from the sniffing thread when a receiver reports frames dropped
+	 * before reaching it (e.g. the socket buffer overflowed), with the number
+	 * of new drops and the total since the receiver was created. The drops
+	 * are noticed when the next frame is received.
+	 */
+	void setOnDrop(OnDropPtr dropCB) { mDropCB = dropCB; }
 	void setData(void *data) { mData = data; }
 };
 
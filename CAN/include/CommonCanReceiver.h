@@ -8,10 +8,15 @@
 #ifndef COMMONCANRECEIVER_H_
 #define COMMONCANRECEIVER_H_
 
+#include <atomic>
+#include <memory>
 #include <set>
+#include <unordered_set>
+#include <vector>
 
 #include <Utils.h>
 
+#include <BusStatistics.h>
 #include <CanFilter.h>
 #include <CanFrame.h>
 
@@ -20,8 +25,31 @@ namespace Can
 class CommonCanReceiver
 {
   private:
-	std::set<CanFilter> mFilters;
+	// The filters are grouped by mask, so that a frame is checked with a
+	// lookup per distinct mask instead of a comparison per filter
+	struct MaskGroup {
+		u32 mask;
+		std::unordered_set<u32> ids; // Ids of the filters, masked
+	};
+
+	std::vector<MaskGroup> mFilterGroups;
 	std::string mInterface;
+	std::shared_ptr<BusStatistics> mBusStatistics;
+	int mCpu = -1;
+
+	std::atomic<u64> mDroppedFrames{0};
+	std::atomic<u64> mIntervalDrops{0}; // Since the last takeDroppedFrames()
+
+  protected:
+	/*
+	 * To be called by the backends when they find out that frames have been
+	 * lost before reaching the receiver (e.g. socket buffer overflow)
+	 */
+	void addDroppedFrames(u64 count)
+	{
+		mDroppedFrames += count;
+		mIntervalDrops += count;
+	}
 
   public:
 	CommonCanReceiver() {}
@@ -43,9 +71,73 @@ class CommonCanReceiver
 
 	virtual bool receive(CanFrame &, Utils::TimeStamp &) = 0;
 
+	/*
+	 * Receives up to max frames with their timestamps. Returns the number of
+	 * frames stored in the given arrays. The default implementation receives
+	 * a single frame, backends able to drain several frames per call should
+	 * override it.
+	 */
+	virtual size_t receiveBatch(CanFrame *frames, Utils::TimeStamp *tStamps,
+								size_t max);
+
 	virtual bool filter(u32 id);
 
+	/*
+	 * True if the frames given by the receiver have been already filtered
+	 * by the backend, so that filter() does not need to be called.
+	 */
+	virtual bool isKernelFiltering() const { return false; }
+
 	const std::string &getInterface() const { return mInterface; }
+
+	/*
+	 * Statistics fed with all the frames received, before being filtered. It
+	 * must be set before the filters and before adding the receiver to the
+	 * sniffer, so that the backends filtering in kernel space can get the
+	 * frames not matching them another way.
+	 */
+	virtual void
+	setBusStatistics(const std::shared_ptr<BusStatistics> &statistics)
+	{
+		mBusStatistics = statistics;
+	}
+
+	const std::shared_ptr<BusStatistics> &getBusStatistics() const
+	{
+		return mBusStatistics;
+	}
+
+	/*
+	 * Backends filtering in kernel space feed the statistics from a file
+	 * descriptor of their own, not filtered, which is watched by the sniffer
+	 * along with the receivers. drainStatistics() is called when it is
+	 * readable. -1 if the statistics are fed with the frames received.
+	 */
+	virtual int getStatisticsFD() { return -1; }
+	virtual void drainStatistics() {}
+
+	/*
+	 * True if the statistics also get the frames sent through the interface
+	 * from this host, so that the senders must not count them again
+	 */
+	virtual bool receivesOwnFrames() const { return false; }
+
+	/*
+	 * CPU where the thread draining the receiver should run, -1 for any
+	 */
+	void setCpu(int cpu) { mCpu = cpu; }
+	int getCpu() const { return mCpu; }
+
+	/*
+	 * Frames dropped before being received, since the receiver was created.
+	 * Only reported by the backends able to detect them.
+	 */
+	u64 getDroppedFrames() const { return mDroppedFrames.load(); }
+
+	/*
+	 * Frames dropped since the previous call, to be polled periodically
+	 */
+	u64 takeDroppedFrames() { return mIntervalDrops.exchange(0); }
 };
 
 } /* namespace Can */
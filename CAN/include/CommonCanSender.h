@@ -10,34 +10,72 @@
 #define BACKENDS_SOCKETS_COMMONCANSENDER_H_
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
 #include <thread>
 
-#include <time.h>
-
+#include <BusStatistics.h>
 #include <ICanSender.h>
+#include <Utils.h>
+
+// Micros in advance a frame can be sent when the rings due at about the same
+// time are to be sent in the same pass, in arbitration order. Kept below the
+// jitter allowed on the periods.
+#define CAN_SENDER_PASS_WINDOW 50
 
 namespace Can
 {
 class CommonCanSender : public ICanSender
 {
+public:
+	/*
+	 * Actual period of a ring, measured between the beginnings of consecutive
+	 * rounds, in micros
+	 */
+	struct PeriodStats {
+		u32 nominal;  // Period given when sending the frames, in millis
+		u64 samples;
+		u64 min;
+		u64 max;
+		u64 mean;
+		u64 jitter; // Mean deviation from the nominal period
+	};
+
 private:
+	typedef std::chrono::steady_clock Clock;
+
 	class CanFrameRing
 	{
 	private:
-		std::vector<CanFrame> mFrames;
-		timespec mTxTimestamp;
+		std::shared_ptr<FramePayloads> mPayloads;
+		Utils::TimeStamp mDeadline; // When the current frame is due
 		u32 mPeriod;
 		size_t mCurrentpos;
 		OnSendCallback mCallback;
+		OnSendRawCallback mRawCallback;
+
+		// Actual period
+		Utils::TimeStamp mRoundStart;
+		u64 mSamples = 0;
+		u64 mMinPeriod = 0;
+		u64 mMaxPeriod = 0;
+		u64 mSumPeriods = 0;
+		u64 mSumDeviations = 0;
 
 	public:
 		CanFrameRing(u32 period, OnSendCallback callback = OnSendCallback())
-			: mPeriod(period), mCurrentpos(0), mCallback(callback)
+			: mDeadline(Utils::TimeStamp::now()), mPeriod(period), mCurrentpos(0),
+			  mCallback(callback)
+		{
+		}
+		CanFrameRing(u32 period, OnSendRawCallback callback)
+			: mDeadline(Utils::TimeStamp::now()), mPeriod(period), mCurrentpos(0),
+			  mRawCallback(callback)
 		{
-			mTxTimestamp = {0, 0};
 		}
 		~CanFrameRing() {}
 		CanFrameRing(const CanFrameRing &other) = default;
@@ -45,26 +83,91 @@ private:
 		CanFrameRing(CanFrameRing &&other) = default;
 		CanFrameRing &operator=(CanFrameRing &&other) = default;
 
-		void setTxTimestamp(timespec timeStamp) { mTxTimestamp = timeStamp; }
-		timespec getTxTimestamp() const { return mTxTimestamp; }
+		void setDeadline(const Utils::TimeStamp &deadline) { mDeadline = deadline; }
+		const Utils::TimeStamp &getDeadline() const { return mDeadline; }
 
-		void pushFrame(const CanFrame &frame);
 		void setFrames(const std::vector<CanFrame> &);
 		void shift();
-		CanFrame &getCurrentFrame() { return mFrames[mCurrentpos]; }
+		CanFrame &getCurrentFrame();
 		u32 getCurrentPeriod() const;
-		const std::vector<CanFrame> &getFrames() const { return mFrames; }
+		u32 getPeriod() const { return mPeriod; }
+		bool isRoundStart() const { return mCurrentpos == 0; }
+		void measureRound(const Utils::TimeStamp &now);
+		PeriodStats getPeriodStats() const;
+		const std::vector<CanFrame> &getFrames() const
+		{
+			return mPayloads->getFrames();
+		}
+		const std::shared_ptr<FramePayloads> &getPayloads() const
+		{
+			return mPayloads;
+		}
 		const OnSendCallback &getCallback() { return mCallback; }
+		const OnSendRawCallback &getRawCallback() { return mRawCallback; }
+	};
+
+	// Hash of the sequence of ids of a ring
+	struct IdSequenceHash {
+		size_t operator()(const std::vector<u32> &ids) const;
 	};
 
 	mutable std::mutex mFramesLock;
+	std::condition_variable mWakeUp; // Signaled when the rings change
 	std::vector<CanFrameRing> mFrameRings;
+
+	// Index in mFrameRings of the ring sending the given sequence of ids
+	std::unordered_map<std::vector<u32>, size_t, IdSequenceHash> mRingIndex;
+
+	// Min-heap of indexes in mFrameRings, ordered by deadline
+	class RingDeadlineGreater;
+	std::vector<size_t> mSchedule;
+
+	// Micros in advance the rings can be taken in a pass
+	u32 mPassWindow;
+
+	// Rings sent so far for every period, to spread their phases
+	bool mPhaseOffsets;
+	std::unordered_map<u32, u32> mPeriodRings;
+
 	bool mFinished;
 	std::unique_ptr<std::thread> mThread = nullptr;
+	OnSendErrorCallback mErrorCallback;
+	std::shared_ptr<BusStatistics> mBusStatistics;
+
+	// Frames due in the current scheduling pass, sent together, and the
+	// rings they are taken from, scheduled again at the end of the pass
+	std::vector<CanFrame> mDueFrames;
+	std::vector<size_t> mDueRings;
+
+	// Frames whose raw callback gave a length beyond their buffer
+	std::vector<CanFrame> mPassErrors;
+
+	// Given to the OnSendCallback callbacks, reused to avoid allocations
+	std::string mCallbackData;
+
+	SendHandle addRing(CanFrameRing &&ring);
+
+	void rebuildSchedule();
+	void removeRing(size_t index);
+	static std::vector<u32> getIds(const std::vector<CanFrame> &frames);
+	static Utils::TimeStamp getPhaseOffset(u32 index, u32 period);
+	void scheduleRing(size_t index, const Utils::TimeStamp &now);
 
 protected:
 	virtual void _sendFrame(const CanFrame &frame) const = 0;
 
+	/*
+	 * Sends all the given frames. Backends able to send several frames in a
+	 * single call should override it, by default _sendFrame() is called for
+	 * every frame. Returns the number of frames successfully sent.
+	 */
+	virtual size_t _sendFrames(const CanFrame *frames, size_t count) const;
+
+	/*
+	 * To be called by the backends when a frame could not be sent
+	 */
+	void notifySendError(const CanFrame &frame, int error) const;
+
 public:
 	CommonCanSender();
 	virtual ~CommonCanSender();
@@ -72,20 +175,71 @@ public:
 	// ICanSender implementation
 	bool initialize();
 	bool finalize();
-	bool sendFrame(CanFrame frame, u32 period,
-				   OnSendCallback callback = OnSendCallback());
-	bool sendFrames(std::vector<CanFrame> frames, u32 period,
-					OnSendCallback callback = OnSendCallback());
+	SendHandle sendFrame(CanFrame frame, u32 period,
+						 OnSendCallback callback = OnSendCallback());
+	SendHandle sendFrame(CanFrame frame, u32 period,
+						 OnSendRawCallback callback) override;
+	SendHandle sendFrames(std::vector<CanFrame> frames, u32 period,
+						  OnSendCallback callback = OnSendCallback());
+	SendHandle sendFrames(std::vector<CanFrame> frames, u32 period,
+						  OnSendRawCallback callback) override;
+	bool updateFrames(const std::vector<CanFrame> &frames) override;
 
 	/*
 	 * Sends the frame given as argument to the CAN network only once.
 	 */
-	void sendFrameOnce(const CanFrame &frame) override { _sendFrame(frame); }
+	void sendFrameOnce(const CanFrame &frame) override;
 	void unSendFrame(u32 id);
 	void unSendFrames(const std::vector<u32> &ids);
 	bool isSent(const std::vector<u32> &ids);
 	bool isSent(u32 id);
 
+	/*
+	 * Sets the callback to be called when a frame cannot be sent. It must be
+	 * set before starting to send frames.
+	 */
+	void setOnSendError(OnSendErrorCallback callback)
+	{
+		mErrorCallback = callback;
+	}
+
+	/*
+	 * Statistics fed with the frames sent. It must be set before starting to
+	 * send frames.
+	 */
+	void setBusStatistics(const std::shared_ptr<BusStatistics> &statistics)
+	{
+		mBusStatistics = statistics;
+	}
+
+	/*
+	 * If enabled, the rings sent afterwards with the same period as other
+	 * rings start at different phases within the period, instead of all of
+	 * them being due at the same time. Disabled by default.
+	 */
+	void setPhaseOffsets(bool enable);
+
+	/*
+	 * The rings due within the given micros are sent in the same pass as
+	 * the earliest one, sorted by arbitration order, at the cost of sending
+	 * them up to that much in advance. 0 by default, only the rings already
+	 * due are sent together.
+	 */
+	void setPassWindow(u32 micros);
+
+	/*
+	 * Statistics of the actual period of the ring sending the given sequence
+	 * of ids. Returns false if the frames are not being sent.
+	 */
+	bool getPeriodStats(const std::vector<u32> &ids, PeriodStats &stats) const;
+
+	/*
+	 * Key to sort the frames by the order in which they win the bus
+	 * arbitration, the lowest first. A base frame wins over an extended frame
+	 * with the same 11 most significant bits.
+	 */
+	static u32 getArbitrationKey(const CanFrame &frame);
+
 	void run();
 };
 
@@ -18,8 +18,34 @@ namespace Can
 {
 class ICanHelper
 {
+  public:
+	/*
+	 * Tuning of an interface, to trade CPU for latency. The sizes of the
+	 * buffers are in bytes, 0 keeps the default of the system.
+	 */
+	struct Tuning {
+		int rcvBuf = 0;
+		int sndBuf = 0;
+		bool forceBuffers = false; // Beyond net.core.[rw]mem_max, needs
+								   // CAP_NET_ADMIN
+		int busyPoll = 0; // Micros to busy poll the device when receiving
+		int rxCpu = -1;	  // CPU where the frames are received, -1 for any
+		int irqCpu = -1;  // CPU handling the IRQs of the device, -1 to leave
+
+		/*
+		 * Sets the option with the given name of the command line (rcvbuf,
+		 * sndbuf, force-buffers, busy-poll, cpu or irq-cpu) from its value.
+		 * Returns false if the name is unknown or the value is not a whole
+		 * number in range, in which case nothing is changed.
+		 */
+		bool parseOption(const std::string &name, const std::string &value);
+	};
+
   private:
 	static std::map<std::string /*Interface*/, ICanHelper *> mHelpers;
+	static std::map<std::string /*Interface*/, Tuning> mTunings;
+
+	int mRxCpu = -1;
 
   public:
 	ICanHelper() {}
@@ -36,6 +62,19 @@ class ICanHelper
 	 */
 	virtual bool initialized() = 0;
 
+	/*
+	 * Applies the tuning to the initialized interface. The default
+	 * implementation only keeps the CPU of the receivers, the backends
+	 * supporting the rest of the options must override it. Returns false if
+	 * any of the options could not be applied.
+	 */
+	virtual bool applyTuning(const Tuning &tuning);
+
+	/*
+	 * CPU to pin the threads receiving from the interface to, or -1
+	 */
+	int getRxCpu() const { return mRxCpu; }
+
 	/*
 	 * Allocates a CanSender, the caller is in charge of the deallocation
 	 */
@@ -53,6 +92,15 @@ class ICanHelper
 	static const std::map<std::string /*Interface*/, ICanHelper *> &
 	createCanHelpers(u32 bitrate);
 
+	/*
+	 * Tuning applied to the interface when its helper is created, for all
+	 * the interfaces if empty. Must be called before creating the helpers.
+	 */
+	static void setTuning(const std::string &interface, const Tuning &tuning)
+	{
+		mTunings[interface] = tuning;
+	}
+
 	static void deallocateCanHelpers();
 };
 
@@ -14,6 +14,7 @@
 #include <Types.h>
 
 #include <CanFrame.h>
+#include <SendHandle.h>
 
 #include <functional>
 
@@ -21,6 +22,22 @@ namespace Can
 {
 typedef std::function<void(u32, std::string &)> OnSendCallback;
 
+/*
+ * Same as OnSendCallback, but the payload is written in place in the buffer
+ * of the frame, without any allocation. The length is the size of the buffer
+ * (8 bytes, 64 for CAN FD frames) and must be set to the number of bytes
+ * written, not beyond it: a larger length is cut to the size of the buffer
+ * and reported to the OnSendErrorCallback with EMSGSIZE. It is called from
+ * the sender thread, it must not block.
+ */
+typedef std::function<void(u32, u8 *, size_t &)> OnSendRawCallback;
+
+/*
+ * Called when the backend fails to send a frame. The second argument is the
+ * errno value (or backend specific error code) reported by the backend.
+ */
+typedef std::function<void(const CanFrame &, int)> OnSendErrorCallback;
+
 class ICanSender
 {
   public:
@@ -28,10 +45,13 @@ class ICanSender
 	virtual ~ICanSender() {}
 
 	/**
-	 * Sends a frame through the can interface with the specified period
+	 * Sends a frame through the can interface with the specified period.
+	 * The returned handle updates the data of the frame while it is sent.
 	 */
-	virtual bool sendFrame(CanFrame frame, u32 period,
-						   OnSendCallback callback = OnSendCallback()) = 0;
+	virtual SendHandle sendFrame(CanFrame frame, u32 period,
+								 OnSendCallback callback = OnSendCallback()) = 0;
+	virtual SendHandle sendFrame(CanFrame frame, u32 period,
+								 OnSendRawCallback callback) = 0;
 
 	/**
 	 * Stops sending the frame whose id matches the given argument
@@ -40,10 +60,23 @@ class ICanSender
 
 	/*
 	 * Sends periodically a set of frames within the given period in the order
-	 * defined in the vector.
+	 * defined in the vector. The returned handle updates the data of the
+	 * frames without blocking their transmission, it is invalid if the
+	 * frames could not be sent.
+	 */
+	virtual SendHandle sendFrames(std::vector<CanFrame> frames, u32 period,
+								  OnSendCallback callback = OnSendCallback()) = 0;
+	virtual SendHandle sendFrames(std::vector<CanFrame> frames, u32 period,
+								  OnSendRawCallback callback) = 0;
+
+	/*
+	 * Replaces the data of a set of frames being sent, whose ids must match
+	 * the ones given to sendFrames() in the same order. Unlike sendFrames(),
+	 * the period and the schedule of the frames are kept. Returns false if
+	 * the frames are not being sent. Prefer the handle returned by
+	 * sendFrames(), which does not look the frames up.
 	 */
-	virtual bool sendFrames(std::vector<CanFrame> frames, u32 period,
-							OnSendCallback callback = OnSendCallback()) = 0;
+	virtual bool updateFrames(const std::vector<CanFrame> &frames) = 0;
 
 	virtual void sendFrameOnce(const CanFrame &frame) = 0;
 
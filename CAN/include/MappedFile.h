@@ -0,0 +1,49 @@
+/*
+ * MappedFile.h
+ *
+ *  Read only view of a whole file mapped in memory.
+ */
+
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+
+#include <string>
+
+#include <Types.h>
+
+namespace Can
+{
+class MappedFile
+{
+  private:
+	const char *mData;
+	size_t mSize;
+	s64 mModificationTime; // Nanoseconds from the epoch
+	bool mOpen;
+
+  public:
+	MappedFile() : mData(nullptr), mSize(0), mModificationTime(0), mOpen(false)
+	{
+	}
+	MappedFile(const MappedFile &other) = delete;
+	virtual ~MappedFile();
+
+	MappedFile &operator=(const MappedFile &other) = delete;
+
+	/*
+	 * Maps the whole file. Empty files can be opened, with no data.
+	 */
+	bool open(const std::string &path);
+	void close();
+
+	bool isOpen() const { return mOpen; }
+
+	const char *data() const { return mData; }
+	const char *end() const { return mData + mSize; }
+	size_t size() const { return mSize; }
+	s64 getModificationTime() const { return mModificationTime; }
+};
+
+} /* namespace Can */
+
+#endif /* MAPPEDFILE_H_ */
@@ -0,0 +1,78 @@
+/*
+ * SendHandle.h
+ *
+ *  Handle to update the payloads of a set of frames sent periodically,
+ *  without blocking the thread in charge of sending them.
+ */
+
+#ifndef SENDHANDLE_H_
+#define SENDHANDLE_H_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <TripleBuffer.h>
+
+#include <CanFrame.h>
+
+namespace Can
+{
+/*
+ * Payloads of the frames of a ring. The producers publish them through a
+ * triple buffer, so that the sender thread always reads a consistent set of
+ * payloads without waiting for any lock.
+ */
+class FramePayloads
+{
+  private:
+	std::mutex mWriteLock; // Serializes the producers
+	Utils::TripleBuffer<std::vector<CanFrame>> mBuffer;
+
+  public:
+	FramePayloads(const std::vector<CanFrame> &frames) : mBuffer(frames) {}
+
+	/*
+	 * Producer side. Copies the data of the given frames, whose ids must
+	 * match the ones of the ring in the same order.
+	 */
+	bool publish(const std::vector<CanFrame> &frames);
+
+	/*
+	 * Sender thread side. Takes the last published payloads, if any.
+	 */
+	bool fetch() { return mBuffer.fetch(); }
+	std::vector<CanFrame> &getFrames() { return mBuffer.front(); }
+	const std::vector<CanFrame> &getFrames() const { return mBuffer.front(); }
+};
+
+class SendHandle
+{
+  private:
+	// Expires when the frames stop being sent
+	std::weak_ptr<FramePayloads> mPayloads;
+
+  public:
+	SendHandle() {}
+	SendHandle(const std::shared_ptr<FramePayloads> &payloads)
+		: mPayloads(payloads)
+	{
+	}
+
+	/*
+	 * Replaces the data of the frames, whose ids must match the ones given to
+	 * ICanSender::sendFrames() in the same order. The new data is sent from
+	 * the next round of the ring on. Returns false if the frames are not
+	 * being sent anymore.
+	 */
+	bool updateFrames(const std::vector<CanFrame> &frames) const;
+	bool updateFrame(const CanFrame &frame) const;
+
+	bool isValid() const { return !mPayloads.expired(); }
+
+	explicit operator bool() const { return isValid(); }
+};
+
+} /* namespace Can */
+
+#endif /* SENDHANDLE_H_ */
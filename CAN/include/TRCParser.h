@@ -0,0 +1,56 @@
+/*
+ * TRCParser.h
+ *
+ *  Tokenizer of the records of a TRC file held in memory. It does not depend
+ *  on the locale nor on streams, and it is stateless once the header has
+ *  been parsed, so that several threads can share it.
+ */
+
+#ifndef TRCPARSER_H_
+#define TRCPARSER_H_
+
+#include <vector>
+
+#include <Utils.h>
+
+#include <CanFrame.h>
+
+namespace Can
+{
+class TRCParser
+{
+  public:
+	enum Result {
+		FRAME,
+		EMPTY, // Blank line or not a data frame (status, error, remote...)
+		ERROR,
+	};
+
+  private:
+	// Layout of the records, given by the version of the file
+	std::vector<char> mColumns;
+	u8 mMajorVersion;
+
+  public:
+	TRCParser() : mMajorVersion(1) {}
+
+	/*
+	 * Takes the version and the columns from the comment lines at the
+	 * beginning of the file. Returns false if they are not supported.
+	 */
+	bool parseHeader(const char *begin, const char *end);
+
+	/*
+	 * Parses the line starting at pos, which is left at the beginning of the
+	 * next one. Comment lines are skipped and belong to the next record.
+	 * The number is the one of the first column, starting at 1.
+	 */
+	Result parseLine(const char *&pos, const char *end, u32 &number,
+					 Utils::TimeStamp &tStamp, CanFrame &frame) const;
+
+	u8 getMajorVersion() const { return mMajorVersion; }
+};
+
+} /* namespace Can */
+
+#endif /* TRCPARSER_H_ */
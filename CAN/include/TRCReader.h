@@ -8,53 +8,190 @@
 #ifndef TRCREADER_H_
 #define TRCREADER_H_
 
+#include <atomic>
 #include <deque>
 #include <exception>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include <Types.h>
 
 #include "CanFrame.h"
+#include <MappedFile.h>
+#include <TRCParser.h>
+#include <Utils.h>
 
 #define MAX_LOADED_FRAMES 1000000
 
+// Frames between two entries of the index of the file
+#define TRC_INDEX_INTERVAL 1024
+
+// The index is kept next to the file, with the same name plus this extension
+#define TRC_INDEX_EXTENSION ".idx"
+
+// Average size of a record (classic frame of 8 bytes), to estimate the number
+// of frames before the file has been scanned
+#define TRC_ESTIMATED_RECORD_SIZE 56
+
+// Frames scanned between two updates of the estimation
+#define TRC_SCAN_PROGRESS_INTERVAL 4096
+
+// Bytes of the chunks in which the files are split to be parsed in parallel
+#define TRC_PARALLEL_CHUNK_SIZE (4 * 1024 * 1024)
+
+// Chunks parsed ahead of the one handed to the callback, per thread
+#define TRC_PARALLEL_CHUNKS_AHEAD 2
+
 namespace Can
 {
 class TRCReadException : public std::exception
 {
+  public:
+	const char *what() const noexcept override
+	{
+		return "Malformed TRC record";
+	}
 };
 
+/*
+ * Called with the frames of the file in order, a chunk at a time. Returning
+ * false stops the parsing.
+ */
+typedef std::function<bool(const CanFrame *frames,
+						   const Utils::TimeStamp *tStamps, size_t count)>
+	OnTRCFramesCallback;
+
 class TRCReader
 {
   private:
 	std::string mFileName;
 	size_t mCurrentPos;
-	size_t mTotalFrames;
-	std::ifstream mFileStream;
-	std::pair<u64, CanFrame> mLastReadFrameTimePair;
+	std::pair<Utils::TimeStamp, CanFrame> mLastReadFrameTimePair;
+
+	// Set from the scan thread in lazy mode
+	std::atomic<size_t> mTotalFrames;
+	std::atomic<bool> mExactFrames;
+	std::atomic<size_t> mScannedFrames;
+	std::atomic<size_t> mScannedBytes;
+	std::atomic<bool> mStopScan;
+	std::thread mScanThread;
+
+	// The records are parsed straight from the mapped file
+	MappedFile mFile;
+	TRCParser mParser;
+	size_t mOffset; // Of the next line to read
+
+	// Sparse index, one entry every TRC_INDEX_INTERVAL frames
+	struct IndexEntry {
+		u64 offset;	  // Of the line of the frame
+		u64 position; // Of the frame
+		s64 time;	  // Nanoseconds
+	};
+	std::vector<IndexEntry> mIndex;
+	mutable std::mutex mIndexLock; // Published by the scan thread
 
 	void readNextLine(bool &error, bool &empty);
 
+	/*
+	 * Reads the lines from the given offset until the predicate, given the
+	 * position and time stamp of every frame read, returns true
+	 */
+	template <typename Predicate>
+	bool readUntil(size_t offset, Predicate predicate);
+
+	/*
+	 * Parses the whole file, building the index. Returns false at the
+	 * first malformed record, with the frames up to it.
+	 */
+	bool scanFile(std::vector<IndexEntry> &index, size_t &frames);
+
 	bool checkIntegrity();
+	void scanInBackground();
+
+	/*
+	 * The index file is only taken if its size and modification time match
+	 * the ones of the file, in which case the integrity check is skipped
+	 */
+	bool loadIndex();
+	void saveIndex(const std::vector<IndexEntry> &index, size_t frames) const;
 
   public:
+	enum LoadMode {
+		CHECKED, // Checked and indexed before returning
+		LAZY,	 // Checked and indexed by a thread
+		MAPPED,	 // Neither checked nor indexed
+	};
+
 	TRCReader();
 	TRCReader(const std::string &path);
 	virtual ~TRCReader();
 
-	bool loadFile(const std::string &path);
+	/*
+	 * In lazy mode the frames can be read right away, while the file is
+	 * checked and indexed by a thread. Until it finishes, the number of
+	 * frames is estimated and the malformed records are only found when
+	 * read. In mapped mode only the header is read and nothing is written
+	 * next to the file, for the callers going once through it with
+	 * parseFrames(): the number of frames stays estimated.
+	 */
+	bool loadFile(const std::string &path, LoadMode mode = CHECKED);
 	void unloadFile();
 	bool isFileLoaded() const { return !mFileName.empty(); }
-	size_t getNumberOfFrames() const { return mTotalFrames; }
+
+	/*
+	 * The position of a frame is the number of its record minus one, so the
+	 * number of frames is the number of the last one, records which are not
+	 * frames included. Exact once the whole file has been checked, otherwise
+	 * estimated from the records checked so far.
+	 */
+	size_t getNumberOfFrames() const;
+	bool isNumberOfFramesExact() const { return mExactFrames; }
+
 	size_t getCurrentPos() const { return mCurrentPos; }
+
+	/*
+	 * True when there is nothing else to read
+	 */
+	bool isEndOfFile() const { return mOffset >= mFile.size(); }
+
+	/*
+	 * The frame at the given position, or the next one if the record at it is
+	 * not a frame, becomes the last read frame. The reader is not moved if
+	 * there is none.
+	 */
 	bool seekPosition(size_t pos);
-	void seekTime(u32 millis);
-	std::pair<u64, CanFrame> getLastCanFrame();
+
+	/*
+	 * Same for the first frame whose time stamp is not earlier than the
+	 * given one. The time stamps are supposed to be in order.
+	 */
+	bool seekTime(const Utils::TimeStamp &tStamp);
+
+	std::pair<Utils::TimeStamp, CanFrame> getLastCanFrame();
+
+	/*
+	 * Throws TRCReadException if the next record is malformed, which can
+	 * only happen in lazy or mapped mode
+	 */
 	void readNextCanFrame();
 
+	/*
+	 * Parses the whole file with several threads (as many as cores if 0),
+	 * each one taking a chunk of lines at a time, and hands the frames to the
+	 * callback in order. The numbers of the records must follow each other,
+	 * also from a chunk to the next one. Returns false if a record is
+	 * malformed, the numbers do not follow or the callback stops it. The
+	 * position of the reader is not changed.
+	 */
+	bool parseFrames(const OnTRCFramesCallback &callback, size_t threads = 0,
+					 size_t chunkSize = TRC_PARALLEL_CHUNK_SIZE) const;
+
 	/*
 	 * Resets the reader to the beginning
 	 */
@@ -18,18 +18,28 @@ namespace Can
 {
 class TRCWriter
 {
+  public:
+	/*
+	 * Version 1.1 only supports classic frames. Version 2.0 is needed to
+	 * write CAN FD frames.
+	 */
+	enum Version { VERSION_1_1, VERSION_2_0 };
+
   private:
 	std::ofstream mFileStream;
 	unsigned int mCounter;
+	Version mVersion;
+
+	static const char *getType(const CanFrame &frame);
 
   public:
 	TRCWriter();
-	TRCWriter(const std::string &file);
+	TRCWriter(const std::string &file, Version version = VERSION_1_1);
 	virtual ~TRCWriter();
 
 	void write(const CanFrame &frame, const Utils::TimeStamp &timeStamp);
 
-	bool open(const std::string &file);
+	bool open(const std::string &file, Version version = VERSION_1_1);
 	void close();
 
 	class TRCWriteException : public std::exception
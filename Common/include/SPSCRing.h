@@ -0,0 +1,116 @@
+/*
+ * SPSCRing.h
+ *
+ *  Lock-free ring buffer for a single producer thread and a single consumer
+ *  thread. The capacity is rounded up to a power of two, so that the indexes
+ *  can run freely and be masked when accessing the slots.
+ */
+
+#ifndef SPSCRING_H_
+#define SPSCRING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "Types.h"
+
+// Keeps the indexes written by each side in different cache lines
+#define SPSC_RING_CACHE_LINE 64
+
+namespace Utils {
+
+template<class T>
+class SPSCRing {
+
+private:
+	std::vector<T> mSlots;
+	size_t mMask;
+
+	// Written by the consumer
+	std::atomic<size_t> mHead;
+	char mPadHead[SPSC_RING_CACHE_LINE - sizeof(std::atomic<size_t>)];
+
+	// Written by the producer
+	std::atomic<size_t> mTail;
+	std::atomic<size_t> mHighWaterMark;
+	char mPadTail[SPSC_RING_CACHE_LINE - 2 * sizeof(std::atomic<size_t>)];
+
+	static size_t roundUp(size_t capacity) {
+		size_t size = 1;
+		while (size < capacity)
+			size <<= 1;
+		return size;
+	}
+
+public:
+	explicit SPSCRing(size_t capacity) : mSlots(roundUp(capacity)),
+			mMask(mSlots.size() - 1), mHead(0), mTail(0), mHighWaterMark(0) {}
+
+	SPSCRing(const SPSCRing& other) = delete;
+	SPSCRing& operator=(const SPSCRing& other) = delete;
+
+	/*
+	 * Producer side. Returns false if the ring is full.
+	 */
+	bool push(const T& item) {
+
+		size_t tail = mTail.load(std::memory_order_relaxed);
+		size_t used = tail - mHead.load(std::memory_order_acquire);
+
+		if (used == mSlots.size())
+			return false;
+
+		mSlots[tail & mMask] = item;
+		mTail.store(tail + 1, std::memory_order_release);
+
+		// Only the producer updates the high water mark
+		if (used + 1 > mHighWaterMark.load(std::memory_order_relaxed))
+			mHighWaterMark.store(used + 1, std::memory_order_relaxed);
+
+		return true;
+	}
+
+	/*
+	 * Consumer side. Returns false if the ring is empty.
+	 */
+	bool pop(T& item) {
+
+		size_t head = mHead.load(std::memory_order_relaxed);
+
+		if (head == mTail.load(std::memory_order_acquire))
+			return false;
+
+		item = mSlots[head & mMask];
+		mHead.store(head + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	/*
+	 * Approximate when called from a thread other than the producer or the
+	 * consumer.
+	 */
+	size_t size() const {
+		// The head first, so that the tail read afterwards is not behind it.
+		// Both may have moved in between, hence the clamping.
+		size_t head = mHead.load(std::memory_order_acquire);
+		size_t tail = mTail.load(std::memory_order_acquire);
+
+		return std::min(tail - head, capacity());
+	}
+
+	size_t capacity() const { return mSlots.size(); }
+
+	/*
+	 * Maximum number of items that have been stored at the same time
+	 */
+	size_t getHighWaterMark() const {
+		return mHighWaterMark.load(std::memory_order_relaxed);
+	}
+
+};
+
+} /* namespace Utils */
+
+#endif /* SPSCRING_H_ */
@@ -0,0 +1,76 @@
+/*
+ * TripleBuffer.h
+ *
+ *  Lock-free exchange of a value between a single writer thread and a single
+ *  reader thread. The writer fills the back buffer and publishes it, the
+ *  reader takes the last published buffer. None of them ever waits for the
+ *  other, and the reader never sees a buffer while it is being written.
+ */
+
+#ifndef TRIPLEBUFFER_H_
+#define TRIPLEBUFFER_H_
+
+#include <atomic>
+
+#include "Types.h"
+
+// Set in the middle index when it holds a buffer not taken by the reader yet
+#define TRIPLE_BUFFER_DIRTY 0x4
+#define TRIPLE_BUFFER_INDEX_MASK 0x3
+
+namespace Utils {
+
+template<class T>
+class TripleBuffer {
+
+private:
+	T mBuffers[3];
+
+	u8 mFront;					// Owned by the reader
+	std::atomic<u8> mMiddle;	// Exchanged by both sides
+	u8 mBack;					// Owned by the writer
+
+public:
+	explicit TripleBuffer(const T& initial) : mFront(0), mMiddle(1),
+			mBack(2) {
+		for (int i = 0; i < 3; ++i) {
+			mBuffers[i] = initial;
+		}
+	}
+
+	TripleBuffer(const TripleBuffer& other) = delete;
+	TripleBuffer& operator=(const TripleBuffer& other) = delete;
+
+	/*
+	 * Writer side. The contents of the back buffer are the ones of an older
+	 * publication, they must be completely rewritten before publishing them.
+	 */
+	T& back() { return mBuffers[mBack]; }
+
+	void publish() {
+		mBack = mMiddle.exchange(mBack | TRIPLE_BUFFER_DIRTY,
+				std::memory_order_acq_rel) & TRIPLE_BUFFER_INDEX_MASK;
+	}
+
+	/*
+	 * Reader side. Takes the last published buffer, if any. Returns true if
+	 * the front buffer changed.
+	 */
+	bool fetch() {
+		if (!(mMiddle.load(std::memory_order_relaxed) & TRIPLE_BUFFER_DIRTY))
+			return false;
+
+		mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) &
+				TRIPLE_BUFFER_INDEX_MASK;
+
+		return true;
+	}
+
+	T& front() { return mBuffers[mFront]; }
+	const T& front() const { return mBuffers[mFront]; }
+
+};
+
+} /* namespace Utils */
+
+#endif /* TRIPLEBUFFER_H_ */
@@ -25,31 +25,44 @@ timespec addMillis(timespec* time, u32 millis);
 
 
 
+/*
+ * Time stamp with nanosecond resolution, stored as a single signed 64 bits
+ * count of nanoseconds so that the arithmetic does not need to handle carries.
+ */
 class TimeStamp {
 private:
-	u32 mSeconds;
-	u32 mMicroSec;
+	s64 mNanoSec;
 
 public:
-	TimeStamp(): mSeconds(0), mMicroSec(0) {}
-	TimeStamp(u32 seconds, u32 microSec) : mSeconds(seconds), mMicroSec(microSec) {}
+	TimeStamp(): mNanoSec(0) {}
+	TimeStamp(u32 seconds, u32 microSec) : mNanoSec((s64)seconds * 1000000000 + (s64)microSec * 1000) {}
 	~TimeStamp() {}
-	u32 getMicroSec() const { return mMicroSec; }
-	void setMicroSec(u32 microSec) { mMicroSec = microSec; }
-	u32 getSeconds() const { return mSeconds; }
-	void setSeconds(u32 seconds) { mSeconds = seconds; }
-
-
-	TimeStamp operator-(const TimeStamp& other) const;
-	TimeStamp operator+(const TimeStamp& other) const;
-	TimeStamp operator-(u32 millis) const;
-	TimeStamp operator+(u32 millis) const;
-	bool operator==(const TimeStamp& other) const { return (mSeconds == other.mSeconds && mMicroSec == other.mMicroSec); };
-	bool operator>(const TimeStamp& other) const;
-	bool operator<(const TimeStamp& other) const;
-	bool operator<=(const TimeStamp& other) const;
-	bool operator>=(const TimeStamp& other) const;
 
+	static TimeStamp fromNanoSec(s64 nanoSec) { TimeStamp retVal; retVal.mNanoSec = nanoSec; return retVal; }
+
+	s64 getNanoSec() const { return mNanoSec; }
+	void setNanoSec(s64 nanoSec) { mNanoSec = nanoSec; }
+	u32 getMicroSec() const { return (mNanoSec % 1000000000) / 1000; }
+	void setMicroSec(u32 microSec) { mNanoSec = (mNanoSec / 1000000000) * 1000000000 + (s64)microSec * 1000; }
+	u32 getSeconds() const { return mNanoSec / 1000000000; }
+	void setSeconds(u32 seconds) { mNanoSec = (s64)seconds * 1000000000 + mNanoSec % 1000000000; }
+
+	/*
+	 * Subtractions saturate to zero, as the time stamps are not negative
+	 */
+	TimeStamp operator-(const TimeStamp& other) const { return fromNanoSec(J1939_MAX(mNanoSec - other.mNanoSec, 0)); }
+	TimeStamp operator+(const TimeStamp& other) const { return fromNanoSec(mNanoSec + other.mNanoSec); }
+	TimeStamp operator-(u32 millis) const { return fromNanoSec(J1939_MAX(mNanoSec - (s64)millis * 1000000, 0)); }
+	TimeStamp operator+(u32 millis) const { return fromNanoSec(mNanoSec + (s64)millis * 1000000); }
+	bool operator==(const TimeStamp& other) const { return mNanoSec == other.mNanoSec; }
+	bool operator>(const TimeStamp& other) const { return mNanoSec > other.mNanoSec; }
+	bool operator<(const TimeStamp& other) const { return mNanoSec < other.mNanoSec; }
+	bool operator<=(const TimeStamp& other) const { return mNanoSec <= other.mNanoSec; }
+	bool operator>=(const TimeStamp& other) const { return mNanoSec >= other.mNanoSec; }
+
+	/*
+	 * Monotonic time
+	 */
 	static TimeStamp now();
 
 };
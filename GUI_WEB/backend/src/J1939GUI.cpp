@@ -98,6 +98,7 @@ using namespace Can;
 using namespace Utils;
 
 bool isFrameSent(const J1939Frame* frame, const std::string& interface);
+std::vector<CanFrame> j1939FrameToCanFrames(const J1939Frame* j1939Frame);
 void sendFrameThroughInterface(const J1939Frame* j1939Frame, u32 period, const std::string& interface);
 void unsendFrameThroughInterface(const J1939Frame* j1939Frame, const std::string& interface);
 
@@ -114,6 +115,15 @@ std::vector<J1939Frame*> framesToSend;
 //Map to specify the period for the different frames (in millis)
 std::map<J1939Frame*, u32> framePeriods;
 
+//Frames sent periodically, by interface and frame. The handles publish the new values of the frames
+//without rescheduling them.
+struct SentFrame {
+	SendHandle handle;
+	u32 period;
+};
+
+std::map<std::pair<std::string, const J1939Frame*>, SentFrame> sentFrames;
+
 //To reassemble frames fragmented by means of Broadcast Announce Message protocol
 BamReassembler reassembler;
 
@@ -500,9 +510,16 @@ bool processRequest(const Json::Value& request, Json::Value& response) {
 		for(auto iter = ifaces.begin(); iter != ifaces.end(); ++iter) {
 			std::shared_ptr<ICanSender> sender = CanEasy::getSender(*iter);
 
-			if(isFrameSent(frame, *iter)) {
+			auto period = framePeriods.find(frame);
+			auto sent = sentFrames.find(std::make_pair(*iter, (const J1939Frame*)frame));
 
-				auto period = framePeriods.find(frame);
+			//If only the data changed, it is published to the sender thread
+			if(period != framePeriods.end() && sent != sentFrames.end() && sent->second.period == period->second &&
+					sent->second.handle.updateFrames(j1939FrameToCanFrames(frame))) {
+				continue;
+			}
+
+			if(isFrameSent(frame, *iter)) {
 
 				if(period != framePeriods.end()) {
 
@@ -727,20 +744,13 @@ bool isFrameSent(const J1939Frame* frame, const std::string& interface) {
 }
 
 
-void sendFrameThroughInterface(const J1939Frame* j1939Frame, u32 period, const std::string& interface) {
-
-	//Sanity check. We do not trust the foreground app
-	std::shared_ptr<ICanSender> sender = CanEasy::getSender(interface);
-
-	if(!sender)		return;
-
-	//Send the frame with the configured periodicity
+std::vector<CanFrame> j1939FrameToCanFrames(const J1939Frame* j1939Frame) {
 
 	size_t length = j1939Frame->getDataLength();
+	std::vector<CanFrame> canFrames;
 	CanFrame canFrame;
 	u32 id;
 	u8* buff;
-	std::string data;
 
 	//J1939 data is always transmitted in extended format
 	canFrame.setExtendedFormat(true);
@@ -748,7 +758,6 @@ void sendFrameThroughInterface(const J1939Frame* j1939Frame, u32 period, const s
 	//If the frame is bigger than 8 bytes, we use BAM
 	if(length > MAX_CAN_DATA_SIZE) {
 
-		std::vector<CanFrame> canFrames;
 		BamFragmenter fragmenter;
 		fragmenter.fragment(*j1939Frame);
 
@@ -795,9 +804,6 @@ void sendFrameThroughInterface(const J1939Frame* j1939Frame, u32 period, const s
 
 		}
 
-		sender->sendFrames(canFrames, period);
-
-
 	} else {			//Can be sent in one frame
 
 		buff = new u8[length];
@@ -815,10 +821,28 @@ void sendFrameThroughInterface(const J1939Frame* j1939Frame, u32 period, const s
 
 		delete[] buff;
 
-		sender->sendFrame(canFrame, period);
+		canFrames.push_back(canFrame);
 
 	}
 
+	return canFrames;
+
+}
+
+
+void sendFrameThroughInterface(const J1939Frame* j1939Frame, u32 period, const std::string& interface) {
+
+	//Sanity check. We do not trust the foreground app
+	std::shared_ptr<ICanSender> sender = CanEasy::getSender(interface);
+
+	if(!sender)		return;
+
+	//Send the frame with the configured periodicity
+	SentFrame& sent = sentFrames[std::make_pair(interface, j1939Frame)];
+
+	sent.handle = sender->sendFrames(j1939FrameToCanFrames(j1939Frame), period);
+	sent.period = period;
+
 }
 
 
@@ -861,6 +885,7 @@ void unsendFrameThroughInterface(const J1939Frame* j1939Frame, const std::string
 		if(interface.empty() || interface == *iter) {
 
 			sender->unSendFrames(ids);
+			sentFrames.erase(std::make_pair(*iter, j1939Frame));
 			found = true;
 		}
 
@@ -890,7 +915,7 @@ void onRcv(const CanFrame& frame, const TimeStamp& ts, const std::string& interf
 	//At least a SPN has changed
 	
 	std::unique_ptr<J1939Frame> j1939Frame = J1939Factory::getInstance().
-				getJ1939Frame(frame.getId(), (const u8*)(frame.getData().c_str()), frame.getData().size());
+				getJ1939Frame(frame.getId(), frame.getRawData(), frame.getDataLength());
 
 	if(!j1939Frame.get()) {			//Frame not registered in the factory.
 		
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <BinaryCaptureReader.h>
+#include <BinaryCaptureWriter.h>
+
+using namespace Can;
+
+#define BIN_CAPTURE_TEST_FILE "binary_capture_test" BIN_CAPTURE_EXTENSION
+
+TEST(BinaryCapture_test, frames) {
+
+	BinaryCaptureWriter writer;
+
+	ASSERT_TRUE(writer.open(BIN_CAPTURE_TEST_FILE));
+	ASSERT_TRUE(writer.setInterface(0, "can0"));
+	ASSERT_TRUE(writer.setInterface(1, "can1"));
+
+	u8 raw[64];
+
+	for (size_t i = 0; i < sizeof(raw); ++i) {
+		raw[i] = i;
+	}
+
+	CanFrame fdFrame(true, 0x18FEF100, raw, 0);
+
+	fdFrame.setFdFormat(true);
+	fdFrame.setBitrateSwitch(true);
+	fdFrame.setData(raw, 10);
+
+	writer.write(CanFrame(true, 0x0CF00400, raw, 8), Utils::TimeStamp(1, 500));
+	writer.write(CanFrame(false, 0x7FF, raw, 3), Utils::TimeStamp(1, 200), 1);
+	writer.write(fdFrame, Utils::TimeStamp(2, 0));
+
+	ASSERT_THROW(writer.write(fdFrame, Utils::TimeStamp(2, 0),
+							  BIN_CAPTURE_MAX_INTERFACES),
+				 BinaryCaptureWriter::BinaryCaptureWriteException);
+
+	writer.close();
+
+	BinaryCaptureReader reader;
+
+	ASSERT_TRUE(reader.loadFile(BIN_CAPTURE_TEST_FILE));
+	ASSERT_EQ(reader.getNumberOfFrames(), 3);
+	ASSERT_EQ(reader.getInterfaceName(1), "can1");
+
+	reader.readNextCanFrame();
+	std::pair<Utils::TimeStamp, CanFrame> pair = reader.getLastCanFrame();
+
+	ASSERT_EQ(reader.getCurrentPos(), 0);
+	ASSERT_EQ(pair.first.getNanoSec(), 1000500000);
+	ASSERT_TRUE(pair.second.isExtendedFormat());
+	ASSERT_EQ(pair.second.getId(), 0x0CF00400);
+	ASSERT_EQ(pair.second.getDataLength(), 8);
+	ASSERT_EQ(memcmp(pair.second.getRawData(), raw, 8), 0);
+	ASSERT_EQ(reader.getLastInterface(), 0);
+
+	// Earlier than the previous one
+	reader.readNextCanFrame();
+	pair = reader.getLastCanFrame();
+
+	ASSERT_EQ(pair.first.getNanoSec(), 1000200000);
+	ASSERT_FALSE(pair.second.isExtendedFormat());
+	ASSERT_EQ(pair.second.getId(), 0x7FF);
+	ASSERT_EQ(pair.second.getDataLength(), 3);
+	ASSERT_EQ(reader.getLastInterface(), 1);
+
+	// Padded to the length of the DLC
+	reader.readNextCanFrame();
+	pair = reader.getLastCanFrame();
+
+	ASSERT_TRUE(pair.second.isFdFormat());
+	ASSERT_TRUE(pair.second.isBitrateSwitch());
+	ASSERT_FALSE(pair.second.isErrorStateIndicator());
+	ASSERT_EQ(pair.second.getDataLength(), 12);
+	ASSERT_EQ(memcmp(pair.second.getRawData(), raw, 10), 0);
+	ASSERT_EQ(pair.second.getRawData()[10], 0);
+
+	ASSERT_TRUE(reader.isEndOfFile());
+
+	reader.readNextCanFrame();
+	ASSERT_EQ(reader.getLastCanFrame().second.getId(), 0);
+
+	unlink(BIN_CAPTURE_TEST_FILE);
+
+}
+
+TEST(BinaryCapture_test, blocks) {
+
+	BinaryCaptureWriter writer;
+
+	ASSERT_TRUE(writer.open(BIN_CAPTURE_TEST_FILE));
+
+	u8 raw[] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+
+	// Several blocks, 1 ms between frames
+	const size_t frames = 20000;
+
+	for (size_t i = 0; i < frames; ++i) {
+		writer.write(CanFrame(true, i, raw, 8), Utils::TimeStamp(0, i * 1000),
+					 i % 4);
+	}
+
+	writer.close();
+
+	BinaryCaptureReader reader(BIN_CAPTURE_TEST_FILE);
+
+	ASSERT_EQ(reader.getNumberOfFrames(), frames);
+	ASSERT_GT(reader.getNumberOfBlocks(), 2);
+
+	size_t positions[] = {frames / 2, 10, 11, frames - 1, 0};
+
+	for (size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); ++i) {
+		ASSERT_TRUE(reader.seekPosition(positions[i]));
+		ASSERT_EQ(reader.getCurrentPos(), positions[i]);
+		ASSERT_EQ(reader.getLastCanFrame().second.getId(), positions[i]);
+		ASSERT_EQ(reader.getLastInterface(), positions[i] % 4);
+	}
+
+	ASSERT_FALSE(reader.seekPosition(frames));
+
+	ASSERT_TRUE(reader.seekTime(Utils::TimeStamp(15, 500500)));
+	ASSERT_EQ(reader.getCurrentPos(), 15501);
+	ASSERT_EQ(reader.getLastCanFrame().first.getNanoSec(), 15501000000);
+
+	reader.readNextCanFrame();
+	ASSERT_EQ(reader.getLastCanFrame().second.getId(), 15502);
+
+	ASSERT_FALSE(reader.seekTime(Utils::TimeStamp(frames, 0)));
+
+	// Without the index nor the last block, as if the recording had been
+	// interrupted
+	ASSERT_EQ(truncate(BIN_CAPTURE_TEST_FILE, BIN_CAPTURE_BLOCK_SIZE * 2), 0);
+
+	ASSERT_TRUE(reader.loadFile(BIN_CAPTURE_TEST_FILE));
+	ASSERT_GT(reader.getNumberOfFrames(), 0);
+	ASSERT_LT(reader.getNumberOfFrames(), frames);
+	ASSERT_EQ(reader.getInterfaceName(0), "");
+
+	size_t read = 0;
+
+	for (; !reader.isEndOfFile(); ++read) {
+		reader.readNextCanFrame();
+		ASSERT_EQ(reader.getLastCanFrame().second.getId(), read);
+	}
+
+	ASSERT_EQ(read, reader.getNumberOfFrames());
+
+	// Not a binary capture
+	FILE *file = fopen(BIN_CAPTURE_TEST_FILE, "w");
+
+	ASSERT_NE(file, nullptr);
+	fputs(";$FILEVERSION=1.1\n", file);
+	fclose(file);
+
+	ASSERT_FALSE(reader.loadFile(BIN_CAPTURE_TEST_FILE));
+
+	unlink(BIN_CAPTURE_TEST_FILE);
+
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <BusStatistics.h>
+
+using namespace Can;
+
+TEST(BusStatistics_test, frame_bits) {
+
+	// 34 dominant bits from the start of frame to the end of the CRC, with a
+	// stuff bit after every 5 of them
+	ASSERT_EQ(BusStatistics::getFrameBits(CanFrame(false, 0x000)), 34 + 6 + 13);
+
+	// Alternating bits, no stuffing in the data field
+	u32 alternating = BusStatistics::getFrameBits(
+		CanFrame(false, 0x555, std::string(8, '\x55')));
+
+	ASSERT_GE(alternating, 111);
+	ASSERT_LE(alternating, 111 + 8);
+
+	// Never above the worst case of the classic frames
+	for (u32 id = 0; id < 0x7FF; id += 0x11) {
+		for (size_t length = 0; length <= MAX_CAN_DATA_SIZE; ++length) {
+			CanFrame frame(false, id, std::string(length, '\0'));
+
+			ASSERT_LE(BusStatistics::getFrameBits(frame),
+					  8 * length + 44 + (34 + 8 * length - 1) / 4 + 3);
+		}
+	}
+
+	CanFrame ext(true, 0x18FEF100, std::string(8, '\xFF'));
+
+	ASSERT_GE(BusStatistics::getFrameBits(ext), 131);
+	ASSERT_LE(BusStatistics::getFrameBits(ext), 8 * 8 + 64 + (54 + 8 * 8 - 1) / 4 + 3);
+}
+
+TEST(BusStatistics_test, load) {
+
+	BusStatistics statistics(250000);
+
+	CanFrame frame(false, 0x000);
+	std::vector<CanFrame> frames(100, frame);
+
+	// 100 frames per window during one second, 200 in the last window
+	for (s64 window = 0; window < BUS_STATS_WINDOWS; ++window) {
+		Utils::TimeStamp tStamp = Utils::TimeStamp::fromNanoSec(
+			(window * BUS_STATS_WINDOW + 50) * 1000000);
+
+		statistics.addFrames(frames.data(), frames.size(), tStamp);
+
+		if (window == BUS_STATS_WINDOWS - 1)
+			statistics.addFrames(frames.data(), frames.size(), tStamp);
+	}
+
+	BusStatistics::Snapshot snapshot = statistics.getSnapshot(
+		Utils::TimeStamp::fromNanoSec((s64)BUS_STATS_WINDOWS * BUS_STATS_WINDOW * 1000000));
+
+	ASSERT_DOUBLE_EQ(snapshot.framesPerSecond, 1100);
+	ASSERT_DOUBLE_EQ(snapshot.bitsPerSecond, 1100 * 53);
+	ASSERT_DOUBLE_EQ(snapshot.load, 100.0 * 1100 * 53 / 250000);
+	ASSERT_DOUBLE_EQ(snapshot.peakLoad, 100.0 * 200 * 53 / 25000);
+	ASSERT_EQ(snapshot.frames, 1100);
+
+	// The windows older than a second do not count anymore
+	snapshot = statistics.getSnapshot(
+		Utils::TimeStamp::fromNanoSec((s64)3 * BUS_STATS_WINDOWS * BUS_STATS_WINDOW * 1000000));
+
+	ASSERT_DOUBLE_EQ(snapshot.load, 0);
+	ASSERT_GT(snapshot.peakLoad, 0);
+
+	statistics.reset();
+
+	ASSERT_EQ(statistics.getSnapshot().frames, 0);
+}
@@ -0,0 +1,468 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <CommonCanSender.h>
+#include <Backends/Virtual/VirtualCanHelper.h>
+
+using namespace Can;
+using namespace Can::Virtual;
+
+// Records the frames sent in every pass
+class RecordingSender : public CommonCanSender {
+private:
+	mutable std::mutex mLock;
+	mutable std::vector<std::vector<CanFrame>> mPasses;
+	mutable std::vector<Utils::TimeStamp> mTimes;
+
+protected:
+	void _sendFrame(const CanFrame &frame) const override
+	{
+		_sendFrames(&frame, 1);
+	}
+
+	size_t _sendFrames(const CanFrame *frames, size_t count) const override
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+
+		mPasses.push_back(std::vector<CanFrame>(frames, frames + count));
+		mTimes.push_back(Utils::TimeStamp::now());
+		return count;
+	}
+
+public:
+	~RecordingSender() { finalize(); }
+
+	std::vector<std::vector<CanFrame>> getPasses() const
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+
+		return mPasses;
+	}
+
+	// When every pass was sent
+	std::vector<Utils::TimeStamp> getTimes() const
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+
+		return mTimes;
+	}
+};
+
+// Drains the receiver, returns the last frame received for every id
+static std::map<u32, CanFrame> lastFrames(CommonCanReceiver *receiver)
+{
+	std::map<u32, CanFrame> frames;
+
+	CanFrame frame;
+	Utils::TimeStamp tStamp;
+
+	while (receiver->receive(frame, tStamp)) {
+		frames[frame.getId()] = frame;
+	}
+
+	return frames;
+}
+
+TEST(CanSender_test, rings) {
+
+	VirtualCanHelper helper;
+
+	ASSERT_TRUE(helper.initialize("vbus_test_rings", 250000));
+
+	std::unique_ptr<CommonCanReceiver> receiver(helper.allocateCanReceiver());
+	std::unique_ptr<ICanSender> sender(helper.allocateCanSender());
+
+	std::vector<CanFrame> frames;
+
+	frames.push_back(CanFrame(true, 0x18FEF100, std::string(8, '\x01')));
+	frames.push_back(CanFrame(true, 0x18FEF200, std::string(8, '\x02')));
+
+	ASSERT_TRUE(sender->sendFrames(frames, 20));
+	ASSERT_TRUE(sender->sendFrame(CanFrame(true, 0x0CF00400, std::string(8, '\x03')), 10));
+
+	ASSERT_TRUE(sender->isSent({0x18FEF100, 0x18FEF200}));
+	ASSERT_FALSE(sender->isSent({0x18FEF200, 0x18FEF100}));
+	ASSERT_FALSE(sender->isSent(0x18FEF100));
+	ASSERT_TRUE(sender->isSent(0x0CF00400));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+	std::map<u32, CanFrame> received = lastFrames(receiver.get());
+
+	ASSERT_EQ(received.size(), 3);
+	ASSERT_EQ(received[0x0CF00400].getData(), std::string(8, '\x03'));
+
+	// Update in place
+	ASSERT_TRUE(sender->updateFrames({CanFrame(true, 0x0CF00400, std::string(8, '\x04'))}));
+	ASSERT_FALSE(sender->updateFrames({CanFrame(true, 0x0CF00500, std::string(8, '\x04'))}));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+	received = lastFrames(receiver.get());
+
+	ASSERT_EQ(received[0x0CF00400].getData(), std::string(8, '\x04'));
+
+	// Removing a ring keeps the others
+	sender->unSendFrames({0x18FEF100, 0x18FEF200});
+
+	ASSERT_FALSE(sender->isSent({0x18FEF100, 0x18FEF200}));
+	ASSERT_TRUE(sender->isSent(0x0CF00400));
+
+	lastFrames(receiver.get()); // Frames sent before removing the ring
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+	received = lastFrames(receiver.get());
+
+	ASSERT_EQ(received.count(0x18FEF100), 0);
+	ASSERT_EQ(received.count(0x0CF00400), 1);
+
+	sender.reset();
+	helper.finalize();
+}
+
+TEST(CanSender_test, handles) {
+
+	VirtualCanHelper helper;
+
+	ASSERT_TRUE(helper.initialize("vbus_test_handles", 250000));
+
+	std::unique_ptr<CommonCanReceiver> receiver(helper.allocateCanReceiver());
+	std::unique_ptr<ICanSender> sender(helper.allocateCanSender());
+
+	std::vector<CanFrame> frames;
+
+	frames.push_back(CanFrame(true, 0x1CECFF00, std::string(8, '\x01')));
+	frames.push_back(CanFrame(true, 0x1CEBFF00, std::string(8, '\x02')));
+
+	SendHandle handle = sender->sendFrames(frames, 10);
+
+	ASSERT_TRUE(handle.isValid());
+
+	frames[0].setData(std::string(8, '\x03'));
+	frames[1].setData(std::string(8, '\x04'));
+
+	ASSERT_TRUE(handle.updateFrames(frames));
+
+	// The ids must match
+	ASSERT_FALSE(handle.updateFrame(frames[0]));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+	std::map<u32, CanFrame> received = lastFrames(receiver.get());
+
+	ASSERT_EQ(received[0x1CECFF00].getData(), std::string(8, '\x03'));
+	ASSERT_EQ(received[0x1CEBFF00].getData(), std::string(8, '\x04'));
+
+	// Sending them again invalidates the previous handle
+	SendHandle other = sender->sendFrames(frames, 10);
+
+	ASSERT_FALSE(handle.updateFrames(frames));
+	ASSERT_TRUE(other.updateFrames(frames));
+
+	sender->unSendFrames({0x1CECFF00, 0x1CEBFF00});
+
+	ASSERT_FALSE(other);
+	ASSERT_FALSE(sender->sendFrames(std::vector<CanFrame>(), 10));
+
+	sender.reset();
+	helper.finalize();
+}
+
+TEST(CanSender_test, raw_callback) {
+
+	VirtualCanHelper helper;
+
+	ASSERT_TRUE(helper.initialize("vbus_test_raw_callback", 250000));
+
+	std::unique_ptr<CommonCanReceiver> receiver(helper.allocateCanReceiver());
+	std::unique_ptr<ICanSender> sender(helper.allocateCanSender());
+
+	u8 counter = 0;
+
+	// Counter and checksum, written in place
+	SendHandle handle = sender->sendFrame(CanFrame(true, 0x0CF00400), 5,
+			[&counter](u32, u8 *data, size_t &length) {
+
+		ASSERT_EQ(length, MAX_CAN_DATA_SIZE);
+
+		data[0] = counter++;
+		data[1] = 0xFF - data[0];
+		length = 2;
+	});
+
+	ASSERT_TRUE(handle);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+	sender->unSendFrame(0x0CF00400);
+
+	CanFrame frame;
+	Utils::TimeStamp tStamp;
+	size_t received = 0;
+
+	while (receiver->receive(frame, tStamp)) {
+		ASSERT_EQ(frame.getDataLength(), 2);
+		ASSERT_EQ(frame.getRawData()[0], received);
+		ASSERT_EQ(frame.getRawData()[1], 0xFF - received);
+		++received;
+	}
+
+	ASSERT_GT(received, 0);
+
+	sender.reset();
+	helper.finalize();
+}
+
+TEST(CanSender_test, raw_callback_overflow) {
+
+	RecordingSender sender;
+
+	std::mutex lock;
+	std::vector<int> errors;
+
+	sender.setOnSendError([&](const CanFrame &frame, int error) {
+		std::lock_guard<std::mutex> guard(lock);
+
+		ASSERT_EQ(frame.getId(), 0x0CF00400);
+		errors.push_back(error);
+	});
+
+	// Beyond the buffer of a classic frame
+	sender.sendFrame(CanFrame(true, 0x0CF00400), 5,
+					 [](u32, u8 *, size_t &length) { length = 100; });
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+	sender.finalize();
+
+	std::vector<std::vector<CanFrame>> passes = sender.getPasses();
+
+	ASSERT_GT(passes.size(), 0);
+
+	// Cut to the buffer
+	for (auto pass = passes.begin(); pass != passes.end(); ++pass) {
+		ASSERT_EQ(pass->size(), 1);
+		ASSERT_EQ((*pass)[0].getDataLength(), MAX_CAN_DATA_SIZE);
+	}
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	ASSERT_EQ(errors.size(), passes.size());
+	ASSERT_EQ(errors[0], EMSGSIZE);
+}
+
+TEST(CanSender_test, arbitration_order) {
+
+	ASSERT_LT(CommonCanSender::getArbitrationKey(CanFrame(false, 0x100)),
+			  CommonCanSender::getArbitrationKey(CanFrame(true, 0x100 << 18)));
+	ASSERT_LT(CommonCanSender::getArbitrationKey(CanFrame(true, 0x0CF00400)),
+			  CommonCanSender::getArbitrationKey(CanFrame(true, 0x18FEF100)));
+	ASSERT_LT(CommonCanSender::getArbitrationKey(CanFrame(true, 0x18FEF100)),
+			  CommonCanSender::getArbitrationKey(CanFrame(false, 0x700)));
+
+	RecordingSender sender;
+
+	// Sent together even if added a few micros apart
+	sender.setPassWindow(CAN_SENDER_PASS_WINDOW);
+
+	// Added from the lowest priority to the highest
+	sender.sendFrame(CanFrame(true, 0x18FEF100), 10);
+	sender.sendFrame(CanFrame(true, 0x18FEF000), 10);
+	sender.sendFrame(CanFrame(true, 0x0CF00400), 10);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(45));
+
+	CommonCanSender::PeriodStats stats;
+
+	ASSERT_TRUE(sender.getPeriodStats({0x0CF00400}, stats));
+	ASSERT_FALSE(sender.getPeriodStats({0x0CF00500}, stats));
+
+	ASSERT_EQ(stats.nominal, 10);
+	ASSERT_GT(stats.samples, 0);
+	ASSERT_GE(stats.mean, 5000);
+	ASSERT_LE(stats.mean, 20000);
+	ASSERT_LE(stats.min, stats.mean);
+	ASSERT_GE(stats.max, stats.mean);
+
+	sender.finalize();
+
+	std::vector<std::vector<CanFrame>> passes = sender.getPasses();
+	bool together = false;
+
+	for (auto pass = passes.begin(); pass != passes.end(); ++pass) {
+		for (size_t i = 1; i < pass->size(); ++i) {
+			ASSERT_LT(CommonCanSender::getArbitrationKey((*pass)[i - 1]),
+					  CommonCanSender::getArbitrationKey((*pass)[i]));
+		}
+
+		together |= (pass->size() == 3);
+	}
+
+	ASSERT_TRUE(together);
+}
+
+TEST(CanSender_test, late_ring_order) {
+
+	RecordingSender sender;
+
+	// TP.CM followed by two TP.DT, which win the arbitration over it
+	std::vector<CanFrame> frames = {CanFrame(true, 0x1CECFF00),
+									CanFrame(true, 0x1CEBFF00),
+									CanFrame(true, 0x1CEBFF01)};
+
+	ASSERT_TRUE(sender.sendFrames(frames, 3));
+
+	// Keeps the scheduler late
+	sender.sendFrame(CanFrame(true, 0x18FEF100), 1,
+					 [](u32, u8 *, size_t &length) {
+						 std::this_thread::sleep_for(
+							 std::chrono::microseconds(900));
+						 length = 0;
+					 });
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	sender.finalize();
+
+	std::vector<std::vector<CanFrame>> passes = sender.getPasses();
+	size_t next = 0, sent = 0;
+
+	// A frame of the ring per pass at most, in the order of the ring
+	for (auto pass = passes.begin(); pass != passes.end(); ++pass) {
+		size_t inPass = 0;
+
+		for (auto frame = pass->begin(); frame != pass->end(); ++frame) {
+			if (frame->getId() == 0x18FEF100)
+				continue;
+
+			ASSERT_EQ(frame->getId(), frames[next].getId());
+			next = (next + 1) % frames.size();
+			++inPass;
+			++sent;
+		}
+
+		ASSERT_LE(inPass, 1);
+	}
+
+	ASSERT_GT(sent, frames.size());
+}
+
+TEST(CanSender_test, never_in_advance) {
+
+	RecordingSender sender;
+
+	// Due 100 micros apart
+	u32 ids[] = {0x0CF00400, 0x18FEF100};
+	Utils::TimeStamp starts[2];
+
+	starts[0] = Utils::TimeStamp::now();
+	sender.sendFrame(CanFrame(true, ids[0]), 10);
+
+	std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+	starts[1] = Utils::TimeStamp::now();
+	sender.sendFrame(CanFrame(true, ids[1]), 10);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	sender.finalize();
+
+	std::vector<std::vector<CanFrame>> passes = sender.getPasses();
+	std::vector<Utils::TimeStamp> times = sender.getTimes();
+	size_t rounds[] = {0, 0};
+
+	// The n-th frame of a ring is not sent before n periods from its start
+	for (size_t i = 0; i < passes.size(); ++i) {
+		for (auto frame = passes[i].begin(); frame != passes[i].end();
+			 ++frame) {
+			size_t ring = (frame->getId() == ids[0] ? 0 : 1);
+			s64 due = starts[ring].getNanoSec() + rounds[ring]++ * 10000000;
+
+			ASSERT_GE(times[i].getNanoSec(), due);
+		}
+	}
+
+	ASSERT_GT(rounds[0], 5);
+	ASSERT_GT(rounds[1], 5);
+}
+
+// Mean deviation of the periods of two rings from their nominal period, the
+// worst of both
+static u64 measureJitter(const std::string &bus)
+{
+	VirtualCanHelper helper;
+
+	if (!helper.initialize(bus, 250000))
+		return UINT64_MAX;
+
+	std::unique_ptr<ICanSender> sender(helper.allocateCanSender());
+	CommonCanSender *commonSender =
+		dynamic_cast<CommonCanSender *>(sender.get());
+
+	// Their phases drift, so that the 7 ms ring is due right after the
+	// other one every now and then
+	sender->sendFrame(CanFrame(true, 0x0CF00400, std::string(8, '\0')), 10);
+	sender->sendFrame(CanFrame(true, 0x18FEF100, std::string(8, '\0')), 7);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+	u64 jitter = 0;
+	u32 ids[] = {0x0CF00400, 0x18FEF100};
+
+	for (size_t i = 0; i < 2; ++i) {
+		CommonCanSender::PeriodStats stats;
+
+		if (!commonSender || !commonSender->getPeriodStats({ids[i]}, stats) ||
+			stats.samples < 20) {
+			jitter = UINT64_MAX;
+			break;
+		}
+
+		jitter = std::max(jitter, stats.jitter);
+	}
+
+	sender.reset();
+	helper.finalize();
+
+	return jitter;
+}
+
+TEST(CanSender_test, period_jitter) {
+
+	// Measured again if the thread was preempted by the rest of the machine,
+	// which takes milliseconds and is not what is measured
+	u64 jitter = UINT64_MAX;
+
+	for (int i = 0; i < 10 && jitter >= 100; ++i) {
+		jitter = measureJitter("vbus_test_period_jitter");
+	}
+
+	// Frames never sent in advance, nor accumulating the delays
+	ASSERT_LT(jitter, 100);
+}
+
+TEST(CanSender_test, phase_offsets) {
+
+	RecordingSender sender;
+
+	sender.setPhaseOffsets(true);
+
+	for (u32 id = 0; id < 4; ++id) {
+		sender.sendFrame(CanFrame(false, 0x100 + id), 20);
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	sender.finalize();
+
+	// Every ring at its own phase, 5 ms apart, instead of the 4 rings being
+	// sent in the same pass every 20 ms
+	ASSERT_GE(sender.getPasses().size(), 6);
+}
@@ -0,0 +1,509 @@
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <net/if.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include <SPSCRing.h>
+#include <CanSniffer.h>
+#include <CommonCanSender.h>
+#include <Backends/Sockets/SocketCanHelper.h>
+#include <Backends/Virtual/VirtualCanHelper.h>
+
+using namespace Can;
+
+// Receives the ids written to a pipe as extended frames
+class PipeReceiver : public CommonCanReceiver {
+private:
+	int mFd;
+
+public:
+	PipeReceiver(int fd) : mFd(fd) { setInterface("pipe"); }
+	~PipeReceiver() { close(mFd); }
+
+	int getFD() override { return mFd; }
+
+	bool receive(CanFrame &frame, Utils::TimeStamp &tStamp) override
+	{
+		u32 id;
+
+		if (read(mFd, &id, sizeof(id)) != sizeof(id))
+			return false;
+
+		frame = CanFrame(true, id);
+		tStamp = Utils::TimeStamp::now();
+		return true;
+	}
+
+	size_t receiveBatch(CanFrame *frames, Utils::TimeStamp *tStamps,
+						size_t max) override
+	{
+		size_t count = 0;
+
+		while (count < max && receive(frames[count], tStamps[count]))
+			++count;
+
+		return count;
+	}
+};
+
+struct SnifferTestData {
+	CanSniffer *sniffer;
+	std::vector<u32> ids;
+	size_t expected;
+	size_t timeouts;
+};
+
+static SnifferTestData testData;
+
+static void onRcv(const CanFrame &frame, const Utils::TimeStamp &,
+				  const std::string &interface, void *)
+{
+	ASSERT_EQ(interface, "pipe");
+
+	testData.ids.push_back(frame.getId());
+
+	if (testData.ids.size() == testData.expected)
+		testData.sniffer->finish();
+}
+
+static bool onTimeout()
+{
+	// Give up if the frames do not arrive
+	if (++testData.timeouts > 100)
+		testData.sniffer->finish();
+
+	return true;
+}
+
+TEST(SPSCRing_test, push_pop) {
+
+	Utils::SPSCRing<u32> ring(3);
+
+	ASSERT_EQ(ring.capacity(), 4);
+
+	for (u32 i = 0; i < 4; ++i) {
+		ASSERT_TRUE(ring.push(i));
+	}
+
+	ASSERT_FALSE(ring.push(4));
+	ASSERT_EQ(ring.size(), 4);
+
+	u32 value;
+
+	for (u32 i = 0; i < 4; ++i) {
+		ASSERT_TRUE(ring.pop(value));
+		ASSERT_EQ(value, i);
+	}
+
+	ASSERT_FALSE(ring.pop(value));
+
+	// The indexes wrap around the slots
+	ASSERT_TRUE(ring.push(5));
+	ASSERT_TRUE(ring.pop(value));
+	ASSERT_EQ(value, 5);
+	ASSERT_EQ(ring.getHighWaterMark(), 4);
+}
+
+TEST(SPSCRing_test, size_from_other_thread) {
+
+	Utils::SPSCRing<u32> ring(8);
+	std::atomic<bool> running(true);
+
+	// Producer and consumer going as fast as they can
+	std::thread producer([&]() {
+		for (u32 i = 0; running; ++i) {
+			ring.push(i);
+		}
+	});
+
+	std::thread consumer([&]() {
+		u32 value;
+		while (running) {
+			ring.pop(value);
+		}
+	});
+
+	bool inRange = true;
+
+	for (int i = 0; i < 1000000 && inRange; ++i) {
+		inRange = ring.size() <= ring.capacity();
+	}
+
+	running = false;
+	producer.join();
+	consumer.join();
+
+	ASSERT_TRUE(inRange);
+}
+
+TEST(CanSniffer_test, pipelined) {
+
+	int fds[2];
+
+	ASSERT_EQ(pipe2(fds, O_NONBLOCK), 0);
+
+	CanSniffer sniffer(onRcv, onTimeout);
+
+	sniffer.addReceiver(new PipeReceiver(fds[0]));
+
+	testData.sniffer = &sniffer;
+	testData.expected = 1000;
+	testData.timeouts = 0;
+
+	for (u32 id = 0; id < testData.expected; ++id) {
+		ASSERT_EQ(write(fds[1], &id, sizeof(id)), (ssize_t)sizeof(id));
+	}
+
+	sniffer.sniffPipelined(10);
+
+	close(fds[1]);
+
+	ASSERT_EQ(testData.ids.size(), testData.expected);
+
+	for (u32 id = 0; id < testData.expected; ++id) {
+		ASSERT_EQ(testData.ids[id], id);
+	}
+
+	CanSniffer::PipelineStats stats = sniffer.getPipelineStats(0);
+
+	ASSERT_EQ(stats.capacity, CAN_SNIFFER_PIPELINE_CAPACITY);
+	ASSERT_EQ(stats.overflows, 0);
+	ASSERT_GT(stats.highWaterMark, 0);
+}
+
+TEST(CanSniffer_test, userspace_filters) {
+
+	int fds[2];
+
+	ASSERT_EQ(pipe2(fds, O_NONBLOCK), 0);
+
+	PipeReceiver receiver(fds[0]);
+
+	close(fds[1]);
+
+	// No filters, everything passes
+	ASSERT_TRUE(receiver.filter(0x18FEF100));
+
+	std::set<CanFilter> filters;
+
+	// PGNs 65265 and 61444 from any source, plus PGN 61444 from the source 0x00
+	filters.insert(CanFilter(0x00FEF100, 0x03FFFF00, true, false));
+	filters.insert(CanFilter(0x00F00400, 0x03FFFF00, true, false));
+	filters.insert(CanFilter(0x00F00400, 0x03FFFFFF, true, false));
+
+	receiver.setFilters(filters);
+
+	ASSERT_TRUE(receiver.filter(0x18FEF100));
+	ASSERT_TRUE(receiver.filter(0x18FEF1AA));
+	ASSERT_TRUE(receiver.filter(0x0CF00400));
+	ASSERT_FALSE(receiver.filter(0x18FEF000));
+	ASSERT_FALSE(receiver.filter(0x0CF00300));
+
+	ASSERT_FALSE(receiver.isKernelFiltering());
+}
+
+// Reports as dropped the frames whose id is missing from the sequence, as a
+// backend would do with the drop counter of the socket
+class GapReceiver : public PipeReceiver {
+private:
+	u32 mNext = 0;
+
+public:
+	GapReceiver(int fd) : PipeReceiver(fd) {}
+
+	bool receive(CanFrame &frame, Utils::TimeStamp &tStamp) override
+	{
+		if (!PipeReceiver::receive(frame, tStamp))
+			return false;
+
+		if (frame.getId() != mNext)
+			addDroppedFrames(frame.getId() - mNext);
+
+		mNext = frame.getId() + 1;
+		return true;
+	}
+};
+
+static std::vector<std::pair<u64, u64>> drops;
+
+static void onDrop(u64 dropped, u64 total, const std::string &interface,
+				   void *)
+{
+	ASSERT_EQ(interface, "pipe");
+
+	drops.push_back(std::make_pair(dropped, total));
+}
+
+TEST(CanSniffer_test, drops) {
+
+	int fds[2];
+
+	ASSERT_EQ(pipe2(fds, O_NONBLOCK), 0);
+
+	GapReceiver *receiver = new GapReceiver(fds[0]);
+
+	CanSniffer sniffer(onRcv, onTimeout);
+
+	sniffer.addReceiver(receiver);
+	sniffer.setOnDrop(onDrop);
+
+	testData.sniffer = &sniffer;
+	testData.ids.clear();
+	testData.expected = 1;
+	testData.timeouts = 0;
+
+	// Nothing lost yet
+	u32 id = 0;
+	ASSERT_EQ(write(fds[1], &id, sizeof(id)), (ssize_t)sizeof(id));
+
+	sniffer.sniff(10);
+
+	ASSERT_TRUE(drops.empty());
+
+	// 2 frames lost before the id 3 and 5 before the id 9
+	u32 ids[] = {3, 9};
+
+	for (size_t i = 0; i < 2; ++i) {
+		ASSERT_EQ(write(fds[1], &ids[i], sizeof(ids[i])), (ssize_t)sizeof(u32));
+
+		++testData.expected;
+		sniffer.reset();
+		sniffer.sniff(10);
+	}
+
+	close(fds[1]);
+
+	ASSERT_EQ(drops.size(), 2);
+	ASSERT_EQ(drops[0], std::make_pair((u64)2, (u64)2));
+	ASSERT_EQ(drops[1], std::make_pair((u64)5, (u64)7));
+
+	ASSERT_EQ(receiver->getDroppedFrames(), 7);
+	ASSERT_EQ(receiver->takeDroppedFrames(), 7);
+	ASSERT_EQ(receiver->takeDroppedFrames(), 0);
+	ASSERT_EQ(receiver->getDroppedFrames(), 7);
+}
+
+// Filters in "kernel space" and feeds the statistics from a second pipe, as
+// the SocketCan receiver does with a socket without filters
+class StatsReceiver : public PipeReceiver {
+private:
+	int mStatsFd;
+
+public:
+	StatsReceiver(int fd, int statsFd) : PipeReceiver(fd), mStatsFd(statsFd) {}
+	~StatsReceiver() { close(mStatsFd); }
+
+	bool isKernelFiltering() const override { return true; }
+
+	int getStatisticsFD() override { return mStatsFd; }
+
+	void drainStatistics() override
+	{
+		u32 id;
+
+		while (read(mStatsFd, &id, sizeof(id)) == sizeof(id)) {
+			CanFrame frame(true, id);
+			getBusStatistics()->addFrames(&frame, 1);
+		}
+	}
+};
+
+TEST(CanSniffer_test, statistics_fd) {
+
+	int fds[2], statsFds[2];
+
+	ASSERT_EQ(pipe2(fds, O_NONBLOCK), 0);
+	ASSERT_EQ(pipe2(statsFds, O_NONBLOCK), 0);
+
+	StatsReceiver *receiver = new StatsReceiver(fds[0], statsFds[0]);
+	std::shared_ptr<BusStatistics> statistics =
+		std::make_shared<BusStatistics>(250000);
+
+	receiver->setBusStatistics(statistics);
+
+	CanSniffer sniffer(onRcv, onTimeout);
+
+	sniffer.addReceiver(receiver);
+
+	// Watched from now on, even if set twice
+	std::set<CanFilter> filters;
+	filters.insert(CanFilter(0x00FEF100, 0x03FFFF00, true, false));
+
+	sniffer.setFilters(filters);
+	sniffer.setFilters(filters);
+
+	testData.sniffer = &sniffer;
+	testData.ids.clear();
+	testData.expected = 1;
+	testData.timeouts = 0;
+
+	// The whole bus through the statistics pipe, the filtered frame through
+	// the other one
+	u32 ids[] = {0x18FEF100, 0x18FEF000, 0x0CF00400};
+
+	ASSERT_EQ(write(statsFds[1], ids, sizeof(ids)), (ssize_t)sizeof(ids));
+	ASSERT_EQ(write(fds[1], ids, sizeof(u32)), (ssize_t)sizeof(u32));
+
+	sniffer.sniff(10);
+
+	close(fds[1]);
+	close(statsFds[1]);
+
+	ASSERT_EQ(testData.ids.size(), 1);
+
+	// Not counted twice
+	ASSERT_EQ(statistics->getSnapshot().frames, 3);
+}
+
+// Sniffs until nothing has been received for a while
+static CanSniffer *ownSniffer;
+static Utils::TimeStamp lastReception;
+
+static void onOwnRcv(const CanFrame &, const Utils::TimeStamp &,
+					 const std::string &, void *)
+{
+	lastReception = Utils::TimeStamp::now();
+}
+
+static bool onOwnTimeout()
+{
+	if ((Utils::TimeStamp::now() - lastReception).getNanoSec() > 50000000)
+		ownSniffer->finish();
+
+	return true;
+}
+
+static void sniffUntilIdle(CanSniffer &sniffer)
+{
+	ownSniffer = &sniffer;
+	lastReception = Utils::TimeStamp::now();
+
+	sniffer.reset();
+	sniffer.sniff(10);
+}
+
+// Wired as CanEasy does, the frames sent from the application are counted
+// once in the bus load, with and without filters
+static void checkOwnFrames(ICanHelper &helper)
+{
+	std::shared_ptr<BusStatistics> statistics =
+		std::make_shared<BusStatistics>(250000);
+
+	CanSniffer sniffer(onOwnRcv, onOwnTimeout);
+
+	CommonCanReceiver *receiver = helper.allocateCanReceiver();
+
+	receiver->setBusStatistics(statistics);
+	sniffer.addReceiver(receiver);
+
+	std::unique_ptr<ICanSender> sender(helper.allocateCanSender());
+	CommonCanSender *commonSender =
+		dynamic_cast<CommonCanSender *>(sender.get());
+
+	if (commonSender && !receiver->receivesOwnFrames())
+		commonSender->setBusStatistics(statistics);
+
+	for (u32 i = 0; i < 5; ++i) {
+		sender->sendFrameOnce(CanFrame(true, 0x18FEF100 + i));
+	}
+
+	sniffUntilIdle(sniffer);
+
+	ASSERT_EQ(statistics->getSnapshot().frames, 5);
+
+	// Not matching the filters
+	std::set<CanFilter> filters;
+	filters.insert(CanFilter(0x0CF00400, 0x1FFFFFFF, true, false));
+
+	sniffer.setFilters(filters);
+
+	for (u32 i = 0; i < 5; ++i) {
+		sender->sendFrameOnce(CanFrame(true, 0x18FEF100 + i));
+	}
+
+	sniffUntilIdle(sniffer);
+
+	ASSERT_EQ(statistics->getSnapshot().frames, 10);
+}
+
+TEST(CanSniffer_test, own_frames_virtual) {
+
+	Virtual::VirtualCanHelper helper;
+
+	ASSERT_TRUE(helper.initialize("vbus_test_own_frames", 250000));
+
+	checkOwnFrames(helper);
+
+	helper.finalize();
+}
+
+TEST(CanSniffer_test, own_frames_socketcan) {
+
+	// Only where a virtual SocketCan interface has been set up
+	if (if_nametoindex("vcan0") == 0)
+		GTEST_SKIP();
+
+	Sockets::SocketCanHelper helper;
+
+	ASSERT_TRUE(helper.initialize("vcan0", 250000));
+
+	checkOwnFrames(helper);
+
+	helper.finalize();
+}
+
+static int rcvCpu;
+
+static void onRcvCpu(const CanFrame &, const Utils::TimeStamp &,
+					 const std::string &, void *)
+{
+	rcvCpu = sched_getcpu();
+	testData.sniffer->finish();
+}
+
+TEST(CanSniffer_test, affinity) {
+
+	cpu_set_t cpus;
+
+	ASSERT_EQ(sched_getaffinity(0, sizeof(cpus), &cpus), 0);
+
+	int cpu = 0;
+
+	// The last CPU we are allowed to run on
+	for (int i = 0; i < CPU_SETSIZE; ++i) {
+		if (CPU_ISSET(i, &cpus))
+			cpu = i;
+	}
+
+	int fds[2];
+
+	ASSERT_EQ(pipe2(fds, O_NONBLOCK), 0);
+
+	PipeReceiver *receiver = new PipeReceiver(fds[0]);
+
+	receiver->setCpu(cpu);
+
+	CanSniffer sniffer(onRcvCpu, onTimeout);
+
+	sniffer.addReceiver(receiver);
+
+	testData.sniffer = &sniffer;
+	testData.timeouts = 0;
+	rcvCpu = -1;
+
+	u32 id = 0;
+	ASSERT_EQ(write(fds[1], &id, sizeof(id)), (ssize_t)sizeof(id));
+
+	// The sniffing thread is pinned, not to pin the one running the tests
+	std::thread thread([&sniffer]() { sniffer.sniff(10); });
+
+	thread.join();
+
+	close(fds[1]);
+
+	ASSERT_EQ(rcvCpu, cpu);
+}
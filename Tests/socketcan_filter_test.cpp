@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+
+#include <Backends/Sockets/SocketCanReceiver.h>
+
+using namespace Can::Sockets;
+
+static bool matches(const std::vector<can_filter> &filters, canid_t id)
+{
+	for (auto filter = filters.begin(); filter != filters.end(); ++filter) {
+		if ((id & filter->can_mask) == (filter->can_id & filter->can_mask))
+			return true;
+	}
+
+	return false;
+}
+
+TEST(SocketCanFilter_test, optimize) {
+
+	const canid_t pgnMask = CAN_EFF_FLAG | 0x03FFFF00;
+
+	std::vector<can_filter> filters = {
+		// TP.CM and TP.DT (PGNs 0xEC00 and 0xEB00) from any source
+		{CAN_EFF_FLAG | 0x00EC0000, CAN_EFF_FLAG | 0x03FF0000},
+		{CAN_EFF_FLAG | 0x00EB0000, CAN_EFF_FLAG | 0x03FF0000},
+		// Subsumed by the previous ones
+		{CAN_EFF_FLAG | 0x00EC00FE, CAN_EFF_FLAG | 0x03FF00FF},
+		// PGNs 0xFEF0 to 0xFEF3, which are reduced to a single filter
+		{CAN_EFF_FLAG | 0x00FEF000, pgnMask},
+		{CAN_EFF_FLAG | 0x00FEF100, pgnMask},
+		{CAN_EFF_FLAG | 0x00FEF200, pgnMask},
+		{CAN_EFF_FLAG | 0x00FEF300, pgnMask},
+		// Duplicated
+		{CAN_EFF_FLAG | 0x00FEF300, pgnMask},
+		// Cannot be merged
+		{CAN_EFF_FLAG | 0x00F00400, pgnMask},
+	};
+
+	std::vector<can_filter> optimized = filters;
+
+	ASSERT_EQ(SocketCanReceiver::optimizeFilters(optimized), 4);
+	ASSERT_EQ(optimized.size(), 4);
+
+	const canid_t ids[] = {0x18ECFF00, 0x18EB00FE, 0x18FEF000, 0x18FEF1AA,
+						   0x18FEF300, 0x0CF00400, 0x18FEF400, 0x18ED0000,
+						   0x0CF00500, 0x18FEE000, 0x00EC0000};
+
+	for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); ++i) {
+		ASSERT_EQ(matches(filters, ids[i] | CAN_EFF_FLAG),
+				  matches(optimized, ids[i] | CAN_EFF_FLAG));
+		ASSERT_EQ(matches(filters, ids[i] & CAN_SFF_MASK),
+				  matches(optimized, ids[i] & CAN_SFF_MASK));
+	}
+}
+
+TEST(SocketCanFilter_test, statistics_socket) {
+
+	// Not a CAN socket, the statistics socket cannot be opened on its
+	// interface
+	int socks[2];
+
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, socks), 0);
+
+	{
+		SocketCanReceiver receiver(socks[0], false);
+
+		receiver.setBusStatistics(std::make_shared<Can::BusStatistics>(250000));
+
+		// Fed with the frames received, which are not the ones sent through
+		// the shared socket
+		ASSERT_EQ(receiver.getStatisticsFD(), -1);
+		ASSERT_FALSE(receiver.receivesOwnFrames());
+	}
+
+	close(socks[0]);
+	close(socks[1]);
+}
@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+
+#include <Backends/Sockets/SocketCanSender.h>
+
+using namespace Can;
+using namespace Can::Sockets;
+
+// Reads the ids of the frames written to the socket
+static std::vector<u32> readIds(int sock, size_t expected)
+{
+	std::vector<u32> ids;
+
+	while (ids.size() < expected) {
+		pollfd fd = {sock, POLLIN, 0};
+
+		if (poll(&fd, 1, 1000) <= 0)
+			break;
+
+		canfd_frame frame;
+
+		if (read(sock, &frame, sizeof(frame)) > 0)
+			ids.push_back(frame.can_id & CAN_EFF_MASK);
+	}
+
+	return ids;
+}
+
+// Gives access to the frames accepted by the backend
+class CountingSender : public SocketCanSender {
+public:
+	CountingSender(int sock) : SocketCanSender(sock) {}
+
+	using SocketCanSender::_sendFrames;
+};
+
+TEST(SocketCanSender_test, tx_queue) {
+
+	// A datagram socket pair stands for the CAN socket, the writer gets
+	// EAGAIN once the reader has a few frames pending
+	int socks[2];
+
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, socks), 0);
+
+	int size = 0; // The kernel rounds it up to its minimum
+
+	ASSERT_EQ(setsockopt(socks[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)), 0);
+
+	std::vector<std::pair<u32, int>> errors;
+
+	{
+		SocketCanSender sender(socks[0]);
+
+		sender.setTxQueueSize(4);
+		sender.setTxPolicy(SocketCanSender::DROP_NEWEST);
+		sender.setOnSendError([&errors](const CanFrame &frame, int error) {
+			errors.push_back(std::make_pair(frame.getId(), error));
+		});
+
+		// Fill the socket, then the queue, then drop
+		u32 id = 0x18FEF100;
+
+		while (sender.getTxStats().dropped == 0) {
+			sender.sendFrameOnce(CanFrame(true, id++));
+			ASSERT_LT(id, 0x18FF0000);
+		}
+
+		SocketCanSender::TxStats stats = sender.getTxStats();
+
+		ASSERT_EQ(stats.depth, 4);
+		ASSERT_EQ(stats.dropped, 1);
+		ASSERT_EQ(errors.size(), 1);
+		ASSERT_EQ(errors[0].first, id - 1);
+		ASSERT_EQ(errors[0].second, ENOBUFS);
+
+		// A frame with higher priority takes the place of a queued one
+		sender.sendFrameOnce(CanFrame(true, 0x0CF00400));
+
+		stats = sender.getTxStats();
+
+		ASSERT_EQ(stats.depth, 4);
+		ASSERT_EQ(stats.dropped, 2);
+		ASSERT_EQ(errors.back().first, id - 2);
+
+		size_t direct = stats.sent;
+
+		// Make room, the queued frames are sent, the high priority one first
+		std::vector<u32> ids = readIds(socks[1], direct + 4);
+
+		ASSERT_EQ(ids.size(), direct + 4);
+		ASSERT_EQ(ids[direct], 0x0CF00400);
+		ASSERT_EQ(ids[direct + 1], id - 5);
+		ASSERT_EQ(ids[direct + 3], id - 3);
+
+		stats = sender.getTxStats();
+
+		ASSERT_EQ(stats.depth, 0);
+		ASSERT_EQ(stats.sent, direct + 4);
+	}
+
+	close(socks[0]);
+	close(socks[1]);
+}
+
+TEST(SocketCanSender_test, accepted_frames) {
+
+	int socks[2];
+
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, socks), 0);
+
+	int size = 0;
+
+	ASSERT_EQ(setsockopt(socks[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)), 0);
+
+	size_t errors = 0;
+
+	{
+		CountingSender sender(socks[0]);
+
+		sender.setTxQueueSize(4);
+		sender.setTxPolicy(SocketCanSender::DROP_NEWEST);
+		sender.setOnSendError([&errors](const CanFrame &, int) { ++errors; });
+
+		std::vector<CanFrame> frames;
+
+		for (u32 id = 0x18FEF100; frames.size() < 4096; ++id) {
+			frames.push_back(CanFrame(true, id));
+		}
+
+		// Written until the socket is full, then 4 queued and the rest
+		// dropped
+		size_t accepted = sender._sendFrames(frames.data(), frames.size());
+
+		SocketCanSender::TxStats stats = sender.getTxStats();
+
+		ASSERT_GT(stats.dropped, 0);
+		ASSERT_EQ(accepted, frames.size() - stats.dropped);
+		ASSERT_EQ(accepted, stats.sent + stats.depth);
+		ASSERT_EQ(errors, stats.dropped);
+
+		// All of them dropped while the queue is full
+		ASSERT_EQ(sender._sendFrames(frames.data(), 2), 0);
+
+		readIds(socks[1], accepted);
+	}
+
+	close(socks[0]);
+	close(socks[1]);
+
+	// Failing once the reader is closed
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, socks), 0);
+	close(socks[1]);
+
+	errors = 0;
+
+	{
+		CountingSender sender(socks[0]);
+
+		sender.setOnSendError([&errors](const CanFrame &, int) { ++errors; });
+
+		CanFrame frames[] = {CanFrame(true, 0x0CF00400), CanFrame(true, 0x18FEF100)};
+
+		ASSERT_EQ(sender._sendFrames(frames, 2), 0);
+		ASSERT_EQ(errors, 2);
+		ASSERT_EQ(sender.getTxStats().depth, 0);
+	}
+
+	close(socks[0]);
+}
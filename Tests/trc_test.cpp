@@ -0,0 +1,490 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <Backends/Virtual/VirtualCanHelper.h>
+#include <CanSniffer.h>
+#include <TRCReader.h>
+#include <TRCWriter.h>
+
+using namespace Can;
+
+#define TRC_TEST_FILE "trc_test.trc"
+
+TEST(TRC_test, classic_frames) {
+
+	TRCWriter writer;
+
+	ASSERT_TRUE(writer.open(TRC_TEST_FILE));
+
+	u8 raw[] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+
+	writer.write(CanFrame(true, 0x18FEF100, raw, 8), Utils::TimeStamp(1, 500));
+	writer.write(CanFrame(true, 0x0CF00400, raw, 3), Utils::TimeStamp(2, 0));
+
+	writer.close();
+
+	TRCReader reader;
+
+	ASSERT_TRUE(reader.loadFile(TRC_TEST_FILE));
+	ASSERT_EQ(reader.getNumberOfFrames(), 2);
+
+	reader.readNextCanFrame();
+	std::pair<Utils::TimeStamp, CanFrame> pair = reader.getLastCanFrame();
+
+	ASSERT_EQ(pair.first.getNanoSec(), 1000500000);
+	ASSERT_EQ(pair.second.getId(), 0x18FEF100);
+	ASSERT_EQ(pair.second.getDataLength(), 8);
+	ASSERT_EQ(memcmp(pair.second.getRawData(), raw, 8), 0);
+
+	reader.readNextCanFrame();
+	pair = reader.getLastCanFrame();
+
+	ASSERT_EQ(pair.first.getNanoSec(), 2000000000);
+	ASSERT_EQ(pair.second.getId(), 0x0CF00400);
+	ASSERT_EQ(pair.second.getDataLength(), 3);
+	ASSERT_FALSE(pair.second.isFdFormat());
+
+	unlink(TRC_TEST_FILE);
+	unlink(TRC_TEST_FILE TRC_INDEX_EXTENSION);
+
+}
+
+TEST(TRC_test, fd_frames) {
+
+	TRCWriter writer;
+
+	CanFrame fdFrame(true, 0x18FEF100);
+
+	u8 raw[MAX_CANFD_DATA_SIZE];
+
+	for (u8 i = 0; i < sizeof(raw); ++i) {
+		raw[i] = i;
+	}
+
+	fdFrame.setFdFormat(true);
+	fdFrame.setBitrateSwitch(true);
+
+	ASSERT_TRUE(fdFrame.setData(raw, sizeof(raw)));
+
+	// Version 1.1 does not support FD frames
+	ASSERT_TRUE(writer.open(TRC_TEST_FILE));
+	ASSERT_THROW(writer.write(fdFrame, Utils::TimeStamp(0, 100)), TRCWriter::TRCWriteException);
+
+	ASSERT_TRUE(writer.open(TRC_TEST_FILE, TRCWriter::VERSION_2_0));
+
+	writer.write(CanFrame(true, 0x0CF00400, raw, 8), Utils::TimeStamp(0, 100));
+	writer.write(fdFrame, Utils::TimeStamp(0, 200));
+
+	writer.close();
+
+	TRCReader reader;
+
+	ASSERT_TRUE(reader.loadFile(TRC_TEST_FILE));
+	ASSERT_EQ(reader.getNumberOfFrames(), 2);
+
+	reader.readNextCanFrame();
+	std::pair<Utils::TimeStamp, CanFrame> pair = reader.getLastCanFrame();
+
+	ASSERT_EQ(pair.first.getNanoSec(), 100000);
+	ASSERT_FALSE(pair.second.isFdFormat());
+	ASSERT_EQ(pair.second.getDataLength(), 8);
+
+	reader.readNextCanFrame();
+	pair = reader.getLastCanFrame();
+
+	ASSERT_EQ(pair.first.getNanoSec(), 200000);
+	ASSERT_TRUE(pair.second.isFdFormat());
+	ASSERT_TRUE(pair.second.isBitrateSwitch());
+	ASSERT_FALSE(pair.second.isErrorStateIndicator());
+	ASSERT_EQ(pair.second.getDataLength(), MAX_CANFD_DATA_SIZE);
+	ASSERT_EQ(memcmp(pair.second.getRawData(), raw, sizeof(raw)), 0);
+
+	unlink(TRC_TEST_FILE);
+	unlink(TRC_TEST_FILE TRC_INDEX_EXTENSION);
+
+}
+
+static void writeFile(const char *contents)
+{
+	FILE *file = fopen(TRC_TEST_FILE, "w");
+
+	ASSERT_NE(file, nullptr);
+	fputs(contents, file);
+	fclose(file);
+}
+
+TEST(TRC_test, hand_written) {
+
+	// CRLF line endings, comments, blank lines and records which are not data
+	// frames
+	writeFile(";$FILEVERSION=2.0\r\n"
+			  ";$COLUMNS=N,O,T,B,I,d,R,L,D\r\n"
+			  ";\r\n"
+			  "      1)      0.0005 DT 1 0CF00400 Rx - 2 AB cd\r\n"
+			  "\r\n"
+			  "      2)   1000.1234567 ST 1 Rx 00000000\r\n"
+			  "; Comment\r\n"
+			  "      3)\t1500.250 FD 1 18FEF100 Rx - 9 00 01 02 03 04 05 06 07 08 09 0A 0B\r\n");
+
+	TRCReader reader;
+
+	ASSERT_TRUE(reader.loadFile(TRC_TEST_FILE));
+	ASSERT_EQ(reader.getNumberOfFrames(), 3);
+
+	reader.readNextCanFrame();
+	std::pair<Utils::TimeStamp, CanFrame> pair = reader.getLastCanFrame();
+
+	ASSERT_EQ(reader.getCurrentPos(), 0);
+	ASSERT_EQ(pair.first.getNanoSec(), 500);
+	ASSERT_EQ(pair.second.getId(), 0x0CF00400);
+	ASSERT_EQ(pair.second.getDataLength(), 2);
+	ASSERT_EQ(pair.second.getRawData()[1], 0xCD);
+
+	// Blank line
+	reader.readNextCanFrame();
+	ASSERT_EQ(reader.getLastCanFrame().second.getId(), 0);
+
+	// Status record, skipped
+	reader.readNextCanFrame();
+	ASSERT_EQ(reader.getLastCanFrame().second.getId(), 0);
+
+	reader.readNextCanFrame();
+	pair = reader.getLastCanFrame();
+
+	ASSERT_EQ(reader.getCurrentPos(), 2);
+	ASSERT_EQ(pair.first.getNanoSec(), 1500250000);
+	ASSERT_TRUE(pair.second.isFdFormat());
+	ASSERT_EQ(pair.second.getDataLength(), 12);
+
+	ASSERT_TRUE(reader.seekPosition(0));
+	ASSERT_EQ(reader.getCurrentPos(), 0);
+
+	// The status record leaves a gap, the next frame is taken
+	ASSERT_TRUE(reader.seekPosition(1));
+	ASSERT_EQ(reader.getCurrentPos(), 2);
+	ASSERT_EQ(reader.getLastCanFrame().second.getId(), 0x18FEF100);
+
+	// Same from the mapped file, not indexed
+	TRCReader mapped;
+
+	ASSERT_TRUE(mapped.loadFile(TRC_TEST_FILE, TRCReader::MAPPED));
+	ASSERT_TRUE(mapped.seekPosition(1));
+	ASSERT_EQ(mapped.getCurrentPos(), 2);
+
+	// Nothing after the last frame, the reader stays where it was
+	ASSERT_FALSE(mapped.seekPosition(3));
+	ASSERT_EQ(mapped.getCurrentPos(), 2);
+	ASSERT_EQ(mapped.getLastCanFrame().second.getId(), 0x18FEF100);
+
+	// A byte of data missing
+	writeFile(";$FILEVERSION=1.1\n"
+			  "      1)         0.500  Rx     18FEF100  3  01 02\n");
+
+	ASSERT_FALSE(reader.loadFile(TRC_TEST_FILE));
+	ASSERT_FALSE(reader.isFileLoaded());
+
+	// Not hexadecimal
+	writeFile(";$FILEVERSION=1.1\n"
+			  "      1)         0.500  Rx     18FEF100  2  01 XY\n");
+
+	ASSERT_FALSE(reader.loadFile(TRC_TEST_FILE));
+
+	// The parenthesis is mandatory in version 1.1
+	writeFile(";$FILEVERSION=1.1\n"
+			  "      1         0.500  Rx     18FEF100  1  01\n");
+
+	ASSERT_FALSE(reader.loadFile(TRC_TEST_FILE));
+
+	unlink(TRC_TEST_FILE);
+	unlink(TRC_TEST_FILE TRC_INDEX_EXTENSION);
+
+}
+
+TEST(TRC_test, index) {
+
+	TRCWriter writer;
+
+	ASSERT_TRUE(writer.open(TRC_TEST_FILE));
+
+	u8 raw[] = {0x01, 0x23, 0x45, 0x67};
+
+	// Several entries of the index, 1 ms between frames
+	const size_t frames = 3 * TRC_INDEX_INTERVAL + 10;
+
+	for (size_t i = 0; i < frames; ++i) {
+		writer.write(CanFrame(true, i, raw, 4), Utils::TimeStamp(0, i * 1000));
+	}
+
+	writer.close();
+
+	unlink(TRC_TEST_FILE TRC_INDEX_EXTENSION);
+
+	TRCReader reader;
+
+	ASSERT_TRUE(reader.loadFile(TRC_TEST_FILE));
+	ASSERT_EQ(reader.getNumberOfFrames(), frames);
+	ASSERT_EQ(access(TRC_TEST_FILE TRC_INDEX_EXTENSION, R_OK), 0);
+
+	size_t positions[] = {2 * TRC_INDEX_INTERVAL + 5, TRC_INDEX_INTERVAL,
+						  TRC_INDEX_INTERVAL - 1, 1, frames - 1};
+
+	for (size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); ++i) {
+		ASSERT_TRUE(reader.seekPosition(positions[i]));
+		ASSERT_EQ(reader.getCurrentPos(), positions[i]);
+		ASSERT_EQ(reader.getLastCanFrame().second.getId(), positions[i]);
+	}
+
+	ASSERT_FALSE(reader.seekPosition(frames));
+
+	// Taken from the index file
+	TRCReader indexed(TRC_TEST_FILE);
+
+	ASSERT_EQ(indexed.getNumberOfFrames(), frames);
+
+	ASSERT_TRUE(indexed.seekTime(Utils::TimeStamp(1, 500500)));
+	ASSERT_EQ(indexed.getCurrentPos(), 1501);
+	ASSERT_EQ(indexed.getLastCanFrame().first.getNanoSec(), 1501000000);
+
+	indexed.readNextCanFrame();
+	ASSERT_EQ(indexed.getLastCanFrame().second.getId(), 1502);
+
+	ASSERT_TRUE(indexed.seekTime(Utils::TimeStamp(0, 0)));
+	ASSERT_EQ(indexed.getCurrentPos(), 0);
+
+	ASSERT_FALSE(indexed.seekTime(Utils::TimeStamp(frames, 0)));
+
+	// The index of the previous file does not match anymore
+	ASSERT_TRUE(writer.open(TRC_TEST_FILE));
+	writer.write(CanFrame(true, 0x18FEF100, raw, 4), Utils::TimeStamp(0, 0));
+	writer.close();
+
+	ASSERT_TRUE(reader.loadFile(TRC_TEST_FILE));
+	ASSERT_EQ(reader.getNumberOfFrames(), 1);
+
+	unlink(TRC_TEST_FILE);
+	unlink(TRC_TEST_FILE TRC_INDEX_EXTENSION);
+
+}
+
+TEST(TRC_test, lazy) {
+
+	TRCWriter writer;
+
+	ASSERT_TRUE(writer.open(TRC_TEST_FILE));
+
+	u8 raw[] = {0x01, 0x23, 0x45, 0x67};
+	const size_t frames = 2 * TRC_SCAN_PROGRESS_INTERVAL;
+
+	for (size_t i = 0; i < frames; ++i) {
+		writer.write(CanFrame(true, i, raw, 4), Utils::TimeStamp(0, i * 1000));
+	}
+
+	writer.close();
+
+	// Malformed record at the end
+	FILE *file = fopen(TRC_TEST_FILE, "a");
+
+	ASSERT_NE(file, nullptr);
+	fputs("  9999)  99.0  Rx  18FEF100  4  01 02\n", file);
+	fclose(file);
+
+	unlink(TRC_TEST_FILE TRC_INDEX_EXTENSION);
+
+	TRCReader reader;
+
+	ASSERT_TRUE(reader.loadFile(TRC_TEST_FILE, TRCReader::LAZY));
+
+	reader.readNextCanFrame();
+	ASSERT_EQ(reader.getLastCanFrame().second.getId(), 0);
+	ASSERT_EQ(reader.getCurrentPos(), 0);
+
+	// Checked in the background
+	for (int i = 0; i < 1000 && !reader.isNumberOfFramesExact(); ++i) {
+		usleep(1000);
+	}
+
+	ASSERT_TRUE(reader.isNumberOfFramesExact());
+	ASSERT_EQ(reader.getNumberOfFrames(), frames);
+
+	// Found when read
+	ASSERT_TRUE(reader.seekPosition(frames - 1));
+	ASSERT_THROW(reader.readNextCanFrame(), TRCReadException);
+
+	// Not indexed, as it is not valid
+	ASSERT_NE(access(TRC_TEST_FILE TRC_INDEX_EXTENSION, F_OK), 0);
+	ASSERT_FALSE(reader.loadFile(TRC_TEST_FILE));
+
+	unlink(TRC_TEST_FILE);
+
+}
+
+TEST(TRC_test, parallel) {
+
+	TRCWriter writer;
+
+	ASSERT_TRUE(writer.open(TRC_TEST_FILE));
+
+	u8 raw[] = {0x01, 0x23, 0x45, 0x67};
+	const size_t frames = 5000;
+
+	for (size_t i = 0; i < frames; ++i) {
+		writer.write(CanFrame(true, i, raw, 4), Utils::TimeStamp(0, i * 1000));
+	}
+
+	writer.close();
+
+	TRCReader reader;
+
+	ASSERT_TRUE(reader.loadFile(TRC_TEST_FILE));
+
+	// Small chunks, to be stitched many times
+	size_t parsed = 0;
+	bool ordered = true;
+
+	ASSERT_TRUE(reader.parseFrames(
+		[&](const CanFrame *canFrames, const Utils::TimeStamp *tStamps,
+			size_t count) {
+			for (size_t i = 0; i < count; ++i, ++parsed) {
+				ordered = ordered && canFrames[i].getId() == parsed &&
+						  tStamps[i].getNanoSec() == (s64)parsed * 1000000;
+			}
+			return true;
+		},
+		4, 4096));
+
+	ASSERT_EQ(parsed, frames);
+	ASSERT_TRUE(ordered);
+
+	// Stopped by the callback
+	size_t calls = 0;
+
+	ASSERT_FALSE(reader.parseFrames(
+		[&calls](const CanFrame *, const Utils::TimeStamp *, size_t) {
+			return ++calls < 3;
+		},
+		2, 4096));
+	ASSERT_EQ(calls, 3);
+
+	// A number missing between two chunks, one line each
+	writeFile(";$FILEVERSION=1.1\n"
+			  "      1)         0.500  Rx     18FEF100  1  01\n"
+			  "      2)         0.600  Rx     18FEF100  1  02\n"
+			  "      4)         0.700  Rx     18FEF100  1  03\n");
+
+	unlink(TRC_TEST_FILE TRC_INDEX_EXTENSION);
+
+	// Only mapped, neither checked nor indexed
+	ASSERT_TRUE(reader.loadFile(TRC_TEST_FILE, TRCReader::MAPPED));
+	ASSERT_FALSE(reader.isNumberOfFramesExact());
+	ASSERT_NE(access(TRC_TEST_FILE TRC_INDEX_EXTENSION, F_OK), 0);
+
+	parsed = 0;
+
+	ASSERT_FALSE(reader.parseFrames(
+		[&parsed](const CanFrame *, const Utils::TimeStamp *, size_t count) {
+			parsed += count;
+			return true;
+		},
+		2, 1));
+	ASSERT_EQ(parsed, 2);
+
+	// Also inside a chunk
+	parsed = 0;
+
+	ASSERT_FALSE(reader.parseFrames(
+		[&parsed](const CanFrame *, const Utils::TimeStamp *, size_t count) {
+			parsed += count;
+			return true;
+		}));
+	ASSERT_EQ(parsed, 2);
+
+	unlink(TRC_TEST_FILE);
+	unlink(TRC_TEST_FILE TRC_INDEX_EXTENSION);
+
+}
+
+// As TRCDumper writes the frames received from the interfaces
+struct DumpTestData {
+	CanSniffer *sniffer;
+	TRCWriter writer;
+	size_t expected;
+	size_t written;
+	size_t timeouts;
+};
+
+static DumpTestData dumpData;
+
+static void onDumpRcv(const CanFrame &frame, const Utils::TimeStamp &tStamp,
+					  const std::string &, void *)
+{
+	dumpData.writer.write(frame, tStamp);
+
+	if (++dumpData.written == dumpData.expected)
+		dumpData.sniffer->finish();
+}
+
+static bool onDumpTimeout()
+{
+	// Give up if the frames do not arrive
+	if (++dumpData.timeouts > 100)
+		dumpData.sniffer->finish();
+
+	return true;
+}
+
+TEST(TRC_test, dump_fd_frames) {
+
+	Virtual::VirtualCanHelper helper;
+
+	ASSERT_TRUE(helper.initialize("vbus_test_dump", 250000));
+
+	std::unique_ptr<ICanSender> sender(helper.allocateCanSender());
+
+	CanSniffer sniffer(onDumpRcv, onDumpTimeout);
+
+	sniffer.addReceiver(helper.allocateCanReceiver());
+
+	dumpData.sniffer = &sniffer;
+	dumpData.expected = 2;
+	dumpData.written = 0;
+	dumpData.timeouts = 0;
+
+	ASSERT_TRUE(dumpData.writer.open(TRC_TEST_FILE, TRCWriter::VERSION_2_0));
+
+	u8 raw[64] = {0x01, 0x23, 0x45, 0x67};
+
+	CanFrame fdFrame(true, 0x18FEF100, raw, 0);
+
+	fdFrame.setFdFormat(true);
+	fdFrame.setData(raw, 64);
+
+	// On a mixed bus
+	sender->sendFrameOnce(CanFrame(true, 0x0CF00400, raw, 8));
+	sender->sendFrameOnce(fdFrame);
+
+	sniffer.sniff(10);
+
+	dumpData.writer.close();
+
+	ASSERT_EQ(dumpData.written, dumpData.expected);
+
+	TRCReader reader;
+
+	ASSERT_TRUE(reader.loadFile(TRC_TEST_FILE));
+	ASSERT_EQ(reader.getNumberOfFrames(), 2);
+
+	reader.readNextCanFrame();
+	ASSERT_FALSE(reader.getLastCanFrame().second.isFdFormat());
+
+	reader.readNextCanFrame();
+	ASSERT_TRUE(reader.getLastCanFrame().second.isFdFormat());
+	ASSERT_EQ(reader.getLastCanFrame().second.getDataLength(), 64);
+
+	sender.reset();
+	helper.finalize();
+
+	unlink(TRC_TEST_FILE);
+	unlink(TRC_TEST_FILE TRC_INDEX_EXTENSION);
+
+}
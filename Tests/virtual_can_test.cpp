@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include <Backends/Virtual/VirtualCanHelper.h>
+#include <Backends/Virtual/VirtualCanReceiver.h>
+
+using namespace Can;
+using namespace Can::Virtual;
+
+TEST(VirtualCan_test, fan_out) {
+
+	VirtualCanHelper helper;
+
+	ASSERT_TRUE(helper.initialize("vbus_test_fan_out", 250000));
+
+	std::unique_ptr<CommonCanReceiver> first(helper.allocateCanReceiver());
+	std::unique_ptr<CommonCanReceiver> second(helper.allocateCanReceiver());
+	std::unique_ptr<ICanSender> sender(helper.allocateCanSender());
+
+	u8 raw[] = {0x01, 0x02, 0x03, 0x04};
+
+	for (u32 id = 0; id < 10; ++id) {
+		sender->sendFrameOnce(CanFrame(true, 0x18FEF100 | id, raw, 4));
+	}
+
+	CanFrame frames[16];
+	Utils::TimeStamp tStamps[16];
+
+	CommonCanReceiver *receivers[] = {first.get(), second.get()};
+
+	for (size_t i = 0; i < 2; ++i) {
+		ASSERT_EQ(receivers[i]->receiveBatch(frames, tStamps, 16), 10);
+
+		for (u32 id = 0; id < 10; ++id) {
+			ASSERT_EQ(frames[id].getId(), 0x18FEF100 | id);
+			ASSERT_EQ(frames[id].getDataLength(), 4);
+		}
+
+		// Nothing else pending
+		ASSERT_EQ(receivers[i]->receiveBatch(frames, tStamps, 16), 0);
+	}
+
+	sender.reset();
+	helper.finalize();
+}
+
+TEST(VirtualCan_test, pacing) {
+
+	VirtualCanBus bus;
+
+	bus.setBitrate(125000);
+	bus.setPacing(true);
+
+	CanFrame frame(true, 0x0CF00400, std::string(8, '\0'));
+
+	// 8 micros per bit at 125 kbit/s
+	u32 bits = BusStatistics::getFrameBits(frame);
+
+	Utils::TimeStamp start = Utils::TimeStamp::now();
+
+	std::vector<CanFrame> frames(10, frame);
+
+	ASSERT_EQ(bus.transmit(frames.data(), frames.size()), 10);
+
+	ASSERT_GE((Utils::TimeStamp::now() - start).getNanoSec(),
+			  10 * bits * 8000);
+}
+
+TEST(VirtualCan_test, tuning) {
+
+	VirtualCanHelper helper;
+
+	ASSERT_TRUE(helper.initialize("vbus_test_tuning", 250000));
+
+	ASSERT_EQ(helper.getRxCpu(), -1);
+
+	ICanHelper::Tuning tuning;
+	tuning.rxCpu = 0;
+
+	ASSERT_TRUE(helper.applyTuning(tuning));
+	ASSERT_EQ(helper.getRxCpu(), 0);
+
+	// No sockets to tune
+	tuning.rcvBuf = 1 << 20;
+
+	ASSERT_FALSE(helper.applyTuning(tuning));
+
+	helper.finalize();
+}
+
+TEST(VirtualCan_test, tuning_options) {
+
+	ICanHelper::Tuning tuning;
+
+	ASSERT_TRUE(tuning.parseOption("rcvbuf", "1048576"));
+	ASSERT_TRUE(tuning.parseOption("busy-poll", "50"));
+	ASSERT_TRUE(tuning.parseOption("cpu", "-1"));
+	ASSERT_TRUE(tuning.parseOption("irq-cpu", "2"));
+	ASSERT_TRUE(tuning.parseOption("force-buffers", ""));
+
+	ASSERT_EQ(tuning.rcvBuf, 1 << 20);
+	ASSERT_EQ(tuning.busyPoll, 50);
+	ASSERT_EQ(tuning.rxCpu, -1);
+	ASSERT_EQ(tuning.irqCpu, 2);
+	ASSERT_TRUE(tuning.forceBuffers);
+
+	// Rejected, without changing the tuning
+	ASSERT_FALSE(tuning.parseOption("sndbuf", "abc"));
+	ASSERT_FALSE(tuning.parseOption("sndbuf", "64k"));
+	ASSERT_FALSE(tuning.parseOption("sndbuf", ""));
+	ASSERT_FALSE(tuning.parseOption("sndbuf", "-1"));
+	ASSERT_FALSE(tuning.parseOption("sndbuf", "99999999999"));
+	ASSERT_FALSE(tuning.parseOption("cpu", "-2"));
+	ASSERT_FALSE(tuning.parseOption("bitrate", "250000"));
+
+	ASSERT_EQ(tuning.sndBuf, 0);
+	ASSERT_EQ(tuning.rxCpu, -1);
+}